@@ -0,0 +1,209 @@
+/**
+BatchRunner.cpp
+
+Runs many demand variants of one network through ParallelSim. The network
+is partitioned once into <output dir>/shared; each scenario then gets its
+own work dir with links to the shared partition nets, only its routes are
+cut, and it runs in a child process with its own port range. Up to the given
+number of scenarios run at once (default: cores / partitions). Per-scenario
+results are aggregated into <output dir>/results.csv.
+
+Manifest: one scenario per line, "<name> <sumo cfg> [sumo options...]",
+'#' starts a comment. All cfgs must use the same net-file.
+
+usage: batchrun <manifest> [partitions] [concurrent runs] [output dir]
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "ParallelSim.h"
+
+struct scenario_t {
+  std::string name;
+  std::string cfg;
+  std::vector<std::string> options;
+};
+
+static std::vector<scenario_t> readManifest(const std::string& file) {
+  std::ifstream in(file);
+  if(!in) {
+    std::cout << "unable to read manifest " << file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<scenario_t> scenarios;
+  std::string line;
+  while(getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    scenario_t s;
+    if(!(words >> s.name >> s.cfg))
+      continue;
+    std::string option;
+    while(words >> option)
+      s.options.push_back(option);
+    scenarios.push_back(s);
+  }
+  return scenarios;
+}
+
+static std::string absolutePath(const std::string& file) {
+  char* abs = realpath(file.c_str(), NULL);
+  if(abs == NULL) {
+    std::cout << "unable to resolve " << file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::string path(abs);
+  free(abs);
+  return path;
+}
+
+// run one scenario in this (child) process and write its summary
+static void runScenario(const scenario_t& s, const std::string& sharedDir, const std::string& dir, int partitions, int port) {
+  // keep the scenario's output apart from the other runs
+  std::string log = dir+"/log.txt";
+  freopen(log.c_str(), "w", stdout);
+  for(int i=0; i<partitions; i++) {
+    std::string net = "part"+std::to_string(i)+".net.xml";
+    unlink((dir+"/"+net).c_str());
+    if(symlink((sharedDir+"/"+net).c_str(), (dir+"/"+net).c_str()) != 0) {
+      perror("symlink");
+      exit(EXIT_FAILURE);
+    }
+  }
+  ParallelSim sim("localhost", port, s.cfg.c_str(), false, partitions);
+  sim.setWorkDir(dir);
+  sim.setStatsOutput(dir+"/partition_stats");
+  sim.setTripinfoOutput(dir+"/tripinfo");
+  sim.setSumoOptions(s.options);
+  sim.getFilePaths();
+  sim.partitionRoutes();
+  sim.startSim();
+
+  double seconds = 0;
+  uint64_t handoffs = 0, teleports = 0, failedAdds = 0;
+  for(const PartitionStats& stats : sim.getPartitionStats()) {
+    if(stats.getElapsed()/1e9 > seconds)
+      seconds = stats.getElapsed()/1e9;
+    handoffs += stats.getHandoffs();
+    teleports += stats.getTeleports();
+    failedAdds += stats.getFailedAdds();
+  }
+  std::ofstream out(dir+"/summary");
+  out << seconds << " " << handoffs << " " << teleports << " " << failedAdds << "\n";
+}
+
+int main(int argc, char* argv[]) {
+  if(argc < 2) {
+    std::cout << "usage: batchrun <manifest> [partitions] [concurrent runs] [output dir]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<scenario_t> scenarios = readManifest(argv[1]);
+  int partitions = argc > 2 ? atoi(argv[2]) : 4;
+  int concurrent = argc > 3 ? atoi(argv[3]) : 0;
+  std::string outputDir = argc > 4 ? argv[4] : "batch";
+  if(scenarios.empty()) {
+    std::cout << "no scenarios in " << argv[1] << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // each partition keeps a core busy
+  if(concurrent <= 0)
+    concurrent = std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN)/partitions);
+
+  mkdir(outputDir.c_str(), 0755);
+  outputDir = absolutePath(outputDir);
+  for(scenario_t& s : scenarios)
+    s.cfg = absolutePath(s.cfg);
+
+  // partition the network once, from the first scenario
+  std::string sharedDir = outputDir+"/shared";
+  mkdir(sharedDir.c_str(), 0755);
+  {
+    ParallelSim sim("localhost", 1337, scenarios[0].cfg.c_str(), false, partitions);
+    sim.setWorkDir(sharedDir);
+    sim.getFilePaths();
+    sim.partitionNetwork(true);
+  }
+
+  // run scenarios, slot k uses ports 1337+k*partitions onwards
+  struct run_t {
+    int scenario;
+    int slot;
+    uint64_t start;
+  };
+  std::map<pid_t, run_t> running;
+  std::vector<bool> slotUsed(concurrent, false);
+  std::vector<int> status(scenarios.size(), -1);
+  std::vector<double> wallSeconds(scenarios.size(), 0);
+  int next = 0;
+  while(next < scenarios.size() || !running.empty()) {
+    if(next < scenarios.size() && running.size() < concurrent) {
+      int slot = 0;
+      while(slotUsed[slot])
+        slot++;
+      int port = 1337+slot*partitions;
+      std::string dir = outputDir+"/"+scenarios[next].name;
+      mkdir(dir.c_str(), 0755);
+      // a summary left from an earlier batch must not count as a result
+      unlink((dir+"/summary").c_str());
+      pid_t pid = fork();
+      if(pid == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+      }
+      if(pid == 0) {
+        runScenario(scenarios[next], sharedDir, dir, partitions, port);
+        exit(EXIT_SUCCESS);
+      }
+      std::cout << "started " << scenarios[next].name << " on ports " << port << "-" << port+partitions-1 << std::endl;
+      slotUsed[slot] = true;
+      running[pid] = {next, slot, PartitionStats::now()};
+      next++;
+      continue;
+    }
+    int childStatus;
+    pid_t pid = wait(&childStatus);
+    if(pid == -1)
+      break;
+    auto it = running.find(pid);
+    if(it == running.end())
+      continue;
+    run_t& r = it->second;
+    status[r.scenario] = WIFEXITED(childStatus) ? WEXITSTATUS(childStatus) : -1;
+    wallSeconds[r.scenario] = (PartitionStats::now()-r.start)/1e9;
+    std::cout << "finished " << scenarios[r.scenario].name << " with status " << status[r.scenario] << std::endl;
+    slotUsed[r.slot] = false;
+    running.erase(it);
+  }
+
+  // aggregate the scenario summaries
+  std::ofstream out(outputDir+"/results.csv");
+  out << "scenario,status,wall_s,sim_loop_s,handoffs,teleports,failed_adds\n";
+  int failed = 0;
+  for(int i=0; i<scenarios.size(); i++) {
+    std::ifstream summary(outputDir+"/"+scenarios[i].name+"/summary");
+    double seconds;
+    uint64_t handoffs, teleports, failedAdds;
+    out << scenarios[i].name << "," << status[i] << "," << wallSeconds[i];
+    if(status[i] == 0 && summary >> seconds >> handoffs >> teleports >> failedAdds)
+      out << "," << seconds << "," << handoffs << "," << teleports << "," << failedAdds << "\n";
+    else {
+      out << ",,,,\n";
+      failed++;
+    }
+  }
+  std::cout << scenarios.size()-failed << " of " << scenarios.size() << " scenarios completed, results in "
+    << outputDir << "/results.csv" << std::endl;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/**
+EventCoordinator.cpp
+
+Drives many partitions from a small pool of worker threads. Each worker
+multiplexes the TraCI connections of its partitions with epoll (poll where
+epoll is unavailable): a step is sent to every partition, and whichever
+response arrives first is decoded first. Border synchronization runs after
+all partitions have stepped, between two barriers of the worker threads.
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#include "TraCIAPI.h"
+#include "PartitionManager.h"
+#include "EventCoordinator.h"
+
+EventCoordinator::EventCoordinator(std::vector<PartitionManager*>& parts, int workers) :
+  parts(parts),
+  numWorkers(workers),
+  running(0) {
+  if(numWorkers > (int)parts.size())
+    numWorkers = parts.size();
+  if(numWorkers < 1)
+    numWorkers = 1;
+}
+
+void EventCoordinator::run() {
+  for(PartitionManager* part : parts)
+    part->startServer();
+  // wait for servers to startup (1 second)
+  usleep(1000000);
+  for(PartitionManager* part : parts) {
+    part->connect();
+    part->prepareSim();
+    if(!part->isFinished())
+      running++;
+  }
+
+  for(PartitionManager* part : parts)
+    part->getStats().startRun();
+  pthread_barrier_init(&barrier, NULL, numWorkers);
+  workers.resize(numWorkers);
+  for(int i=0; i<numWorkers; i++) {
+    workers[i].coordinator = this;
+    workers[i].id = i;
+    if(pthread_create(&workers[i].thread, NULL, workerFunc, &workers[i]) != 0) {
+      printf("Error creating worker %d", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+  for(int i=0; i<numWorkers; i++)
+    pthread_join(workers[i].thread, NULL);
+  pthread_barrier_destroy(&barrier);
+  for(PartitionManager* part : parts)
+    part->getStats().endRun();
+
+  for(PartitionManager* part : parts)
+    part->closeConnection();
+}
+
+void EventCoordinator::pollSteps(int pollFd, std::vector<PartitionManager*>& mine, std::vector<char>& inFlight) {
+  int pending = 0;
+  for(int i=0; i<mine.size(); i++) {
+    // a response may already be complete in the receive buffer
+    if(inFlight[i] && mine[i]->finishStep(false))
+      inFlight[i] = false;
+    pending += inFlight[i];
+  }
+#ifdef __linux__
+  struct epoll_event events[64];
+  while(pending > 0) {
+    int n = epoll_wait(pollFd, events, 64, -1);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      exit(EXIT_FAILURE);
+    }
+    for(int j=0; j<n; j++) {
+      int i = events[j].data.u32;
+      if(inFlight[i] && mine[i]->finishStep(false)) {
+        inFlight[i] = false;
+        pending--;
+      }
+    }
+  }
+#else
+  std::vector<struct pollfd> fds;
+  std::vector<int> index;
+  while(pending > 0) {
+    fds.clear();
+    index.clear();
+    for(int i=0; i<mine.size(); i++) {
+      if(inFlight[i]) {
+        struct pollfd fd = {mine[i]->getSocket(), POLLIN, 0};
+        fds.push_back(fd);
+        index.push_back(i);
+      }
+    }
+    if(poll(&fds[0], fds.size(), -1) < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("poll");
+      exit(EXIT_FAILURE);
+    }
+    for(int j=0; j<fds.size(); j++) {
+      int i = index[j];
+      if(fds[j].revents && mine[i]->finishStep(false)) {
+        inFlight[i] = false;
+        pending--;
+      }
+    }
+  }
+#endif
+}
+
+void EventCoordinator::barrierWait(std::vector<PartitionManager*>& mine) {
+  uint64_t start = PartitionStats::now();
+  pthread_barrier_wait(&barrier);
+  // the worker's partitions all wait with it
+  uint64_t end = PartitionStats::now();
+  for(PartitionManager* part : mine)
+    part->recordBarrier(start, end);
+}
+
+void EventCoordinator::runWorker(int w) {
+  // partitions are dealt out round robin
+  std::vector<PartitionManager*> mine;
+  for(int i=w; i<parts.size(); i+=numWorkers)
+    mine.push_back(parts[i]);
+  std::vector<char> inFlight(mine.size(), false);
+
+  int pollFd = -1;
+#ifdef __linux__
+  pollFd = epoll_create1(0);
+  if(pollFd < 0) {
+    perror("epoll_create1");
+    exit(EXIT_FAILURE);
+  }
+  for(int i=0; i<mine.size(); i++) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    if(epoll_ctl(pollFd, EPOLL_CTL_ADD, mine[i]->getSocket(), &ev) < 0) {
+      perror("epoll_ctl");
+      exit(EXIT_FAILURE);
+    }
+  }
+#endif
+
+  // running only changes before the first barrier, so all workers agree on it
+  while(running > 0) {
+    // send steps to all partitions before waiting for any of them
+    for(int i=0; i<mine.size(); i++) {
+      if(!mine[i]->isFinished()) {
+        mine[i]->setWaiting(false);
+        mine[i]->beginStep();
+        inFlight[i] = true;
+      }
+    }
+    std::vector<char> stepped(inFlight);
+    pollSteps(pollFd, mine, inFlight);
+    for(int i=0; i<mine.size(); i++) {
+      mine[i]->setWaiting(true);
+      if(stepped[i] && mine[i]->isFinished())
+        running--;
+    }
+    // every partition has stepped before borders are synchronized
+    barrierWait(mine);
+    for(int i=0; i<mine.size(); i++) {
+      if(stepped[i]) {
+        mine[i]->synchronizeBorders();
+        // waitForSynch clears the flag, neighbours may still need to update this partition
+        mine[i]->setWaiting(true);
+      }
+    }
+    // decided before the barrier, saving moves the next checkpoint time
+    bool checkpoint = parts[0]->checkpointDue();
+    barrierWait(mine);
+    if(checkpoint) {
+      for(PartitionManager* part : mine)
+        part->saveCheckpoint();
+      pthread_barrier_wait(&barrier);
+      for(PartitionManager* part : mine)
+        part->commitCheckpoint();
+    }
+  }
+
+#ifdef __linux__
+  close(pollFd);
+#endif
+}
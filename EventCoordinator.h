@@ -0,0 +1,52 @@
+/**
+EventCoordinator.h
+
+Class definition for EventCoordinator.
+
+Author: Phillip Taylor
+*/
+
+#ifndef EVENTCOORDINATOR_INCLUDED
+#define EVENTCOORDINATOR_INCLUDED
+
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+#include "Pthread_barrier.h"
+
+class PartitionManager;
+
+class EventCoordinator {
+  private:
+    std::vector<PartitionManager*>& parts;
+    int numWorkers;
+    pthread_barrier_t barrier;
+    // partitions that have not reached their end time
+    std::atomic<int> running;
+    struct worker_t {
+      EventCoordinator* coordinator;
+      int id;
+      pthread_t thread;
+    };
+    std::vector<worker_t> workers;
+    // thread helper function
+    static void * workerFunc(void* w){
+      ((worker_t*)w)->coordinator->runWorker(((worker_t*)w)->id);
+      return NULL;
+    }
+    // drive the partitions assigned to a worker step by step
+    void runWorker(int);
+    // wait for the step responses of the partitions with in flight steps
+    void pollSteps(int, std::vector<PartitionManager*>&, std::vector<char>&);
+    // wait for the other workers, recording the wait for each of the worker's partitions
+    void barrierWait(std::vector<PartitionManager*>&);
+
+  public:
+    // params: partitions, number of worker threads
+    EventCoordinator(std::vector<PartitionManager*>&, int);
+    // start all partitions and return when they have reached their end time
+    void run();
+
+};
+
+#endif
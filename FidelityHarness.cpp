@@ -0,0 +1,214 @@
+/**
+FidelityHarness.cpp
+
+Checks that a parallel run simulates the same traffic as the original
+scenario. Runs the sumo cfg unpartitioned and through ParallelSim, both with
+tripinfo output, and compares arrivals, travel times and teleports. Trips of
+a vehicle split over several partitions are merged by vehicle id; a vehicle
+whose merged trip does not end on the serial arrival lane is counted as lost
+at a border. The parallel run takes the same options as main, so every sync
+engine can be checked, and the chosen engine is recorded in the report.
+
+usage: fidelitycheck [sumo cfg] [partitions] [report csv] [main options]
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tinyxml2.h"
+#include "ParallelSim.h"
+#include "SimOptions.h"
+
+struct trip_t {
+  double depart;
+  double arrival;
+  std::string arrivalLane;
+};
+
+struct run_result_t {
+  std::string mode;
+  double seconds;
+  std::unordered_map<std::string, trip_t> trips;
+  uint64_t teleports;
+  uint64_t failedAdds;
+};
+
+// read tripinfos, merging the trip parts of each vehicle
+static void readTripinfos(const std::string& file, std::unordered_map<std::string, trip_t>& trips) {
+  tinyxml2::XMLDocument doc;
+  tinyxml2::XMLError e = doc.LoadFile(file.c_str());
+  if(e) {
+    std::cout << file << ": " << doc.ErrorIDToName(e) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  tinyxml2::XMLElement* root = doc.FirstChildElement("tripinfos");
+  if(root == nullptr)
+    return;
+  for(tinyxml2::XMLElement* el = root->FirstChildElement("tripinfo"); el != NULL; el = el->NextSiblingElement("tripinfo")) {
+    std::string id = el->Attribute("id");
+    // halo replicas of a neighbour's vehicles are not trips of their own
+    if(id.compare(0, 6, "ghost_") == 0)
+      continue;
+    // vehicles re-entering a partition get a route part suffix
+    int pos = id.find("_part");
+    if(pos != std::string::npos)
+      id = id.substr(0, pos);
+    const char* lane = el->Attribute("arrivalLane");
+    trip_t trip = {el->DoubleAttribute("depart"), el->DoubleAttribute("arrival"), lane ? lane : ""};
+    auto it = trips.find(id);
+    if(it == trips.end()) {
+      trips[id] = trip;
+      continue;
+    }
+    if(trip.depart < it->second.depart)
+      it->second.depart = trip.depart;
+    if(trip.arrival > it->second.arrival) {
+      it->second.arrival = trip.arrival;
+      it->second.arrivalLane = trip.arrivalLane;
+    }
+  }
+}
+
+// run the scenario in a single sumo over TraCI, stepping like a partition does
+static run_result_t runSerial(const char* cfg, int endTime, int port) {
+  char* sumoHome = getenv("SUMO_HOME");
+  if(sumoHome == NULL) {
+    std::cout << "$SUMO_HOME is not set! Must set $SUMO_HOME." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::string binary = std::string(sumoHome)+"/bin/sumo";
+  std::string portStr = std::to_string(port);
+  std::string tripinfoFile = "serial_tripinfo.xml";
+  const char* args[10] = {binary.c_str(), "-c", cfg, "--remote-port", portStr.c_str(), "--start",
+    "--tripinfo-output", tripinfoFile.c_str(), NULL};
+  pid_t pid = fork();
+  if(pid == -1) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+  if(pid == 0) {
+    execv(args[0], (char*const*) args);
+    std::cout << "execv() has failed" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // wait for server to startup (1 second)
+  usleep(1000000);
+
+  run_result_t r;
+  r.mode = "serial";
+  r.teleports = 0;
+  r.failedAdds = 0;
+  TraCIAPI conn;
+  conn.connect("localhost", port);
+  uint64_t start = PartitionStats::now();
+  double simTime = conn.simulation.getTime();
+  while(simTime < endTime) {
+    conn.asyncSimulationStep();
+    std::future<double> time = conn.asyncGetDouble(libsumo::CMD_GET_SIM_VARIABLE, libsumo::VAR_TIME, "");
+    std::future<int> teleports = conn.asyncGetInt(libsumo::CMD_GET_SIM_VARIABLE, libsumo::VAR_TELEPORT_STARTING_VEHICLES_NUMBER, "");
+    conn.flush();
+    simTime = time.get();
+    r.teleports += teleports.get();
+  }
+  r.seconds = (PartitionStats::now()-start)/1e9;
+  conn.close();
+  // tripinfos are complete once sumo has exited
+  waitpid(pid, NULL, 0);
+  readTripinfos(tripinfoFile, r.trips);
+  return r;
+}
+
+static run_result_t runParallel(ParallelSim& sim, int partitions, SimOptions& opts) {
+  opts.apply(sim);
+  sim.setTripinfoOutput("parallel_tripinfo");
+  sim.getFilePaths();
+  sim.partitionNetwork(true);
+  // partitions reap their sumo servers, so the tripinfos are complete once startSim returns
+  sim.startSim();
+
+  run_result_t r;
+  r.mode = opts.getMode();
+  r.seconds = 0;
+  r.teleports = 0;
+  r.failedAdds = 0;
+  const std::vector<PartitionStats>& stats = sim.getPartitionStats();
+  for(const PartitionStats& s : stats) {
+    if(s.getElapsed()/1e9 > r.seconds)
+      r.seconds = s.getElapsed()/1e9;
+    r.teleports += s.getTeleports();
+    r.failedAdds += s.getFailedAdds();
+  }
+  for(int i=0; i<partitions; i++)
+    readTripinfos("parallel_tripinfo_part"+std::to_string(i)+".xml", r.trips);
+  return r;
+}
+
+int main(int argc, char* argv[]) {
+  // positional arguments come before the options
+  int first = 1;
+  while(first < argc && first < 4 && argv[first][0] != '-')
+    first++;
+  SimOptions opts("usage: fidelitycheck [sumo cfg] [partitions] [report csv] [main options]");
+  opts.parse(argc, argv, first);
+  std::string cfg = first > 1 ? argv[1] : opts.get("cfg", "assets/simpleNet.sumocfg");
+  int partitions = atoi(first > 2 ? argv[2] : opts.get("threads", "4").c_str());
+  std::string reportFile = first > 3 ? argv[3] : "fidelity_report.csv";
+  int port = atoi(opts.get("port", "1400").c_str());
+
+  ParallelSim sim(opts.get("host", "localhost"), port, cfg.c_str(), false, partitions);
+  run_result_t serial = runSerial(cfg.c_str(), sim.getEndTime(), port-1);
+  run_result_t parallel = runParallel(sim, partitions, opts);
+
+  // compare every serial trip with its merged parallel trip
+  int matched = 0, lost = 0;
+  double serialTravel = 0, parallelTravel = 0, absDiff = 0;
+  for(auto& it : serial.trips) {
+    auto p = parallel.trips.find(it.first);
+    if(p == parallel.trips.end() || p->second.arrivalLane != it.second.arrivalLane) {
+      lost++;
+      continue;
+    }
+    double s = it.second.arrival-it.second.depart;
+    double q = p->second.arrival-p->second.depart;
+    serialTravel += s;
+    parallelTravel += q;
+    absDiff += fabs(q-s);
+    matched++;
+  }
+  int extra = 0;
+  for(auto& it : parallel.trips) {
+    if(serial.trips.find(it.first) == serial.trips.end())
+      extra++;
+  }
+  double meanSerial = matched ? serialTravel/matched : 0;
+  double meanParallel = matched ? parallelTravel/matched : 0;
+  double deviation = meanSerial > 0 ? 100*(meanParallel-meanSerial)/meanSerial : 0;
+
+  printf("%-32s %10s %8s %10s %10s\n", "mode", "seconds", "trips", "teleports", "failed adds");
+  printf("%-32s %10.3f %8zu %10llu %10llu\n", serial.mode.c_str(), serial.seconds, serial.trips.size(),
+    (unsigned long long)serial.teleports, (unsigned long long)serial.failedAdds);
+  printf("%-32s %10.3f %8zu %10llu %10llu\n", parallel.mode.c_str(), parallel.seconds, parallel.trips.size(),
+    (unsigned long long)parallel.teleports, (unsigned long long)parallel.failedAdds);
+  printf("matched trips: %d  lost at borders: %d  parallel only: %d\n", matched, lost, extra);
+  printf("mean travel time serial: %.2fs  parallel: %.2fs  deviation: %.2f%%  mean abs difference: %.2fs\n",
+    meanSerial, meanParallel, deviation, matched ? absDiff/matched : 0);
+
+  std::ofstream out(reportFile);
+  out << "mode,partitions,serial_s,parallel_s,speedup,serial_trips,parallel_trips,matched,lost,parallel_only,"
+    << "serial_teleports,parallel_teleports,failed_adds,serial_mean_travel_s,parallel_mean_travel_s,"
+    << "travel_deviation_pct,mean_abs_travel_diff_s\n";
+  out << parallel.mode << "," << partitions << "," << serial.seconds << "," << parallel.seconds << ","
+    << (parallel.seconds > 0 ? serial.seconds/parallel.seconds : 0) << "," << serial.trips.size() << ","
+    << parallel.trips.size() << "," << matched << "," << lost << "," << extra << "," << serial.teleports << ","
+    << parallel.teleports << "," << parallel.failedAdds << "," << meanSerial << "," << meanParallel << ","
+    << deviation << "," << (matched ? absDiff/matched : 0) << "\n";
+}
@@ -0,0 +1,153 @@
+/**
+MetricsServer.cpp
+
+Serves the live progress of all partitions in Prometheus text format over
+http, on a tcp port or a unix domain socket. Values are read from each
+partition's atomic counters, so scrapes never take the partition locks.
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "TraCIAPI.h"
+#include "PartitionManager.h"
+#include "MetricsServer.h"
+
+MetricsServer::MetricsServer(const std::string& host, int port, std::vector<PartitionManager*>& parts) :
+  host(host),
+  port(port),
+  parts(parts),
+  running(false) {
+  if(host.compare(0, tcpip::Socket::unixPrefix.size(), tcpip::Socket::unixPrefix) == 0)
+    server = new tcpip::Socket(host, 0);
+  else
+    server = new tcpip::Socket(port);
+  // accept polls, so stop() does not have to wake it up
+  server->set_blocking(false);
+}
+
+MetricsServer::~MetricsServer() {
+  stop();
+  delete server;
+}
+
+bool MetricsServer::start() {
+  running = true;
+  if(pthread_create(&myThread, NULL, serveFunc, this) != 0) {
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+void MetricsServer::stop() {
+  if(running) {
+    running = false;
+    pthread_join(myThread, NULL);
+  }
+}
+
+void MetricsServer::serve() {
+  try {
+    while(running) {
+      tcpip::Socket* client = server->accept(true);
+      if(client == nullptr) {
+        usleep(100000);
+        continue;
+      }
+      try {
+        handle(client);
+      }
+      catch(tcpip::SocketException&) {}
+      delete client;
+    }
+  }
+  catch(tcpip::SocketException& e) {
+    std::cout << "metrics endpoint failed: " << e.what() << std::endl;
+  }
+}
+
+void MetricsServer::handle(tcpip::Socket* client) {
+  // read the request header, its content does not matter
+  std::string request;
+  for(int tries=0; request.find("\r\n\r\n") == std::string::npos && tries < 1000; tries++) {
+    std::vector<unsigned char> data = client->receive();
+    if(data.empty())
+      usleep(1000);
+    request.append(data.begin(), data.end());
+  }
+  std::string body = render();
+  std::string header = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+    + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+  std::string response = header+body;
+  client->send(std::vector<unsigned char>(response.begin(), response.end()));
+}
+
+long long MetricsServer::processRSS(int pid) {
+  if(pid <= 0)
+    return -1;
+  std::ifstream statm("/proc/"+std::to_string(pid)+"/statm");
+  long long size, resident;
+  if(!(statm >> size >> resident))
+    return -1;
+  return resident*sysconf(_SC_PAGESIZE);
+}
+
+std::string MetricsServer::render() {
+  struct sample_t {
+    double simTime, stepsPerSec, handoffsPerSec, barrierWait;
+    uint64_t steps, handoffs;
+    int vehicles;
+    long long rss;
+  };
+  std::vector<sample_t> samples;
+  uint64_t now = PartitionStats::now();
+  for(PartitionManager* part : parts) {
+    const partition_metrics_t& m = part->getMetrics();
+    sample_t s;
+    s.simTime = m.simTime;
+    s.steps = m.steps;
+    s.handoffs = m.handoffs;
+    s.vehicles = m.vehicles;
+    s.barrierWait = m.barrierWaitNs/1e9;
+    uint64_t start = m.runStart;
+    double elapsed = start > 0 ? (now-start)/1e9 : 0;
+    s.stepsPerSec = elapsed > 0 ? s.steps/elapsed : 0;
+    s.handoffsPerSec = elapsed > 0 ? s.handoffs/elapsed : 0;
+    s.rss = processRSS(m.sumoPid);
+    samples.push_back(s);
+  }
+
+  std::ostringstream out;
+  out.precision(12);
+  auto metric = [&](const char* name, const char* type, const char* help, std::function<double(const sample_t&)> value) {
+    out << "# HELP parallel_sumo_" << name << " " << help << "\n";
+    out << "# TYPE parallel_sumo_" << name << " " << type << "\n";
+    for(int i=0; i<samples.size(); i++)
+      out << "parallel_sumo_" << name << "{partition=\"" << i << "\"} " << value(samples[i]) << "\n";
+  };
+  metric("sim_time_seconds", "gauge", "Simulation time reached by the partition.",
+    [](const sample_t& s) { return s.simTime; });
+  metric("steps_total", "counter", "Simulation steps completed.",
+    [](const sample_t& s) { return (double)s.steps; });
+  metric("steps_per_second", "gauge", "Mean simulation steps per wall clock second since start.",
+    [](const sample_t& s) { return s.stepsPerSec; });
+  metric("vehicles", "gauge", "Vehicles in the partition's simulation.",
+    [](const sample_t& s) { return (double)s.vehicles; });
+  metric("handoffs_total", "counter", "Vehicles handed to the next partition.",
+    [](const sample_t& s) { return (double)s.handoffs; });
+  metric("handoffs_per_second", "gauge", "Mean handoffs per wall clock second since start.",
+    [](const sample_t& s) { return s.handoffsPerSec; });
+  metric("barrier_wait_seconds_total", "counter", "Wall clock time spent waiting at the step barrier.",
+    [](const sample_t& s) { return s.barrierWait; });
+  out << "# HELP parallel_sumo_sumo_rss_bytes Resident memory of the partition's sumo process.\n";
+  out << "# TYPE parallel_sumo_sumo_rss_bytes gauge\n";
+  for(int i=0; i<samples.size(); i++) {
+    if(samples[i].rss >= 0)
+      out << "parallel_sumo_sumo_rss_bytes{partition=\"" << i << "\"} " << samples[i].rss << "\n";
+  }
+  return out.str();
+}
@@ -0,0 +1,53 @@
+/**
+MetricsServer.h
+
+Class definition for MetricsServer.
+
+Author: Phillip Taylor
+*/
+
+#ifndef METRICSSERVER_INCLUDED
+#define METRICSSERVER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+#include "socket.h"
+
+class PartitionManager;
+
+class MetricsServer {
+  private:
+    std::string host;
+    int port;
+    std::vector<PartitionManager*>& parts;
+    tcpip::Socket* server;
+    pthread_t myThread;
+    std::atomic<bool> running;
+    // thread helper function
+    static void * serveFunc(void* This){
+      ((MetricsServer*)This)->serve();
+      return NULL;
+    }
+    // answer scrapes until stopped
+    void serve();
+    // answer one http request on the connection
+    void handle(tcpip::Socket*);
+    // resident set size of a process in bytes, -1 if unavailable
+    static long long processRSS(int);
+
+  public:
+    // params: host ("unix:<path>" for a unix domain socket, otherwise tcp on all interfaces), port, partitions
+    MetricsServer(const std::string&, int, std::vector<PartitionManager*>&);
+    ~MetricsServer();
+    // start serving in a thread, returns false if the thread could not be started
+    bool start();
+    // stop serving and wait for the thread
+    void stop();
+    // current metrics of all partitions in prometheus text format
+    std::string render();
+
+};
+
+#endif
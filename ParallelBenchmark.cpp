@@ -0,0 +1,97 @@
+/**
+ParallelBenchmark.cpp
+
+Runs a scenario through ParallelSim (headless, metis partitioning) at
+1, 2, 4, 8 and 16 partitions and reports speedup and efficiency against the
+single partition run, handoffs per second and the mean per-partition time
+in each step loop phase. Results are printed and written as CSV.
+
+usage: parallelbench <sumo cfg> [max partitions] [results csv]
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include "ParallelSim.h"
+
+struct bench_result_t {
+  int partitions;
+  double seconds;
+  uint64_t handoffs;
+  uint64_t speedSyncs;
+  // mean over partitions of total time per phase (s)
+  double phaseSeconds[NUM_PHASES];
+};
+
+// partition and run the scenario, timing the step loop only
+static bench_result_t runScenario(const char* cfg, int partitions, int port) {
+  ParallelSim sim("localhost", port, cfg, false, partitions);
+  sim.setStatsOutput("bench_stats"+std::to_string(partitions));
+  sim.getFilePaths();
+  sim.partitionNetwork(true);
+  sim.startSim();
+
+  bench_result_t r = {partitions, 0, 0, 0, {0}};
+  const std::vector<PartitionStats>& stats = sim.getPartitionStats();
+  for(const PartitionStats& s : stats) {
+    // partitions run in lockstep, the slowest one is the run time
+    if(s.getElapsed()/1e9 > r.seconds)
+      r.seconds = s.getElapsed()/1e9;
+    r.handoffs += s.getHandoffs();
+    r.speedSyncs += s.getSpeedSyncs();
+    for(int p=0; p<NUM_PHASES; p++)
+      r.phaseSeconds[p] += s.getTotal(p)/1e9/stats.size();
+  }
+  return r;
+}
+
+int main(int argc, char* argv[]) {
+  if(argc < 2) {
+    std::cout << "usage: parallelbench <sumo cfg> [max partitions] [results csv]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  const char* cfg = argv[1];
+  int maxParts = argc > 2 ? atoi(argv[2]) : 16;
+  std::string resultsFile = argc > 3 ? argv[3] : "bench_results.csv";
+
+  std::vector<bench_result_t> results;
+  // separate port range per run so lingering sockets don't collide
+  int port = 1337;
+  for(int parts=1; parts<=maxParts; parts*=2) {
+    results.push_back(runScenario(cfg, parts, port));
+    port += parts;
+  }
+  if(results.empty())
+    exit(EXIT_FAILURE);
+
+  std::ofstream out(resultsFile);
+  out << "scenario,partitions,seconds,speedup,efficiency,handoffs,handoffs_per_s,speed_syncs";
+  for(int p=0; p<NUM_PHASES; p++)
+    out << "," << PartitionStats::phaseName(p) << "_s";
+  out << "\n";
+  printf("%-10s %10s %8s %10s %10s %12s\n", "partitions", "seconds", "speedup", "efficiency", "handoffs", "handoffs/s");
+  double base = results[0].seconds;
+  for(bench_result_t& r : results) {
+    double speedup = r.seconds > 0 ? base/r.seconds : 0;
+    double handoffRate = r.seconds > 0 ? r.handoffs/r.seconds : 0;
+    printf("%-10d %10.3f %8.2f %10.2f %10llu %12.1f\n", r.partitions, r.seconds, speedup,
+      speedup/r.partitions, (unsigned long long)r.handoffs, handoffRate);
+    out << cfg << "," << r.partitions << "," << r.seconds << "," << speedup << "," << speedup/r.partitions
+      << "," << r.handoffs << "," << handoffRate << "," << r.speedSyncs;
+    for(int p=0; p<NUM_PHASES; p++)
+      out << "," << r.phaseSeconds[p];
+    out << "\n";
+  }
+  printf("mean phase time per partition (s):\n");
+  for(bench_result_t& r : results) {
+    printf("  %2d:", r.partitions);
+    for(int p=0; p<NUM_PHASES; p++)
+      printf(" %s %.3f", PartitionStats::phaseName(p), r.phaseSeconds[p]);
+    printf("\n");
+  }
+}
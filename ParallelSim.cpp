@@ -8,6 +8,7 @@ Author: Phillip Taylor
 */
 
 #include <iostream>
+#include <fstream>
 #include <pthread.h>
 #include <ctime>
 #include <unistd.h>
@@ -15,10 +16,15 @@ Author: Phillip Taylor
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <iterator>
+#include <algorithm>
 #include <unordered_map>
 #include "Pthread_barrier.h"
 #include "tinyxml2.h"
 #include "ParallelSim.h"
+#include "EventCoordinator.h"
+#include "StealingExecutor.h"
+#include "MetricsServer.h"
+#include "TraceRecorder.h"
 
 
 typedef std::unordered_multimap<std::string, int>::iterator umit;
@@ -27,6 +33,18 @@ ParallelSim::ParallelSim(const std::string& host, int port, const char* cfg, boo
   host(host),
   port(port),
   cfgFile(cfg),
+  eventWorkers(0),
+  workStealing(false),
+  statsPrefix("partition_stats"),
+  traciProfiling(false),
+  metricsPort(0),
+  checkpointInterval(0),
+  warmUpTime(0),
+  contextSync(false),
+  haloDepth(0),
+  removalDistance(-1),
+  adaptiveSync(false),
+  barrierType("pthread"),
   numThreads(threads) {
 
   // set paths for sumo executable binaries
@@ -74,6 +92,89 @@ ParallelSim::ParallelSim(const std::string& host, int port, const char* cfg, boo
    }
 }
 
+void ParallelSim::setWorkDir(const std::string& dir){
+  workDir = dir;
+}
+
+std::string ParallelSim::partPath(const std::string& name){
+  if(workDir.empty())
+    return name;
+  return workDir+"/"+name;
+}
+
+void ParallelSim::setUnixSockets(const std::string& dir){
+  // partitions start their own sumo, which has no way to listen on dir/part<i>.sock
+  std::cout << "unix domain sockets in " << dir << " are not supported: sumo only serves TraCI over tcp" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void ParallelSim::setEventWorkers(int workers){
+  eventWorkers = workers;
+}
+
+void ParallelSim::setWorkStealing(bool enabled){
+  workStealing = enabled;
+}
+
+void ParallelSim::setMetricsEndpoint(const std::string& host, int port){
+  metricsHost = host;
+  metricsPort = port;
+}
+
+void ParallelSim::setTripinfoOutput(const std::string& prefix){
+  tripinfoPrefix = prefix;
+}
+
+void ParallelSim::setCheckpointing(const std::string& dir, double interval){
+  checkpointDir = dir;
+  checkpointInterval = interval;
+}
+
+void ParallelSim::restartFrom(const std::string& dir){
+  restartDir = dir;
+}
+
+void ParallelSim::warmUp(const std::string& dir, int time){
+  warmUpDir = dir;
+  warmUpTime = time;
+}
+
+void ParallelSim::setSumoOptions(const std::vector<std::string>& options){
+  sumoOptions = options;
+}
+
+void ParallelSim::setContextSync(bool enabled){
+  contextSync = enabled;
+}
+
+void ParallelSim::setHaloDepth(int depth){
+  haloDepth = depth;
+}
+
+void ParallelSim::setRemovalDistance(double distance){
+  removalDistance = distance;
+}
+
+void ParallelSim::setAdaptiveSync(bool enabled){
+  adaptiveSync = enabled;
+}
+
+void ParallelSim::setBarrier(const std::string& type){
+  barrierType = type;
+}
+
+void ParallelSim::setTraceOutput(const std::string& file){
+  traceFile = file;
+}
+
+void ParallelSim::setTraCIProfiling(bool enabled){
+  traciProfiling = enabled;
+}
+
+void ParallelSim::setStatsOutput(const std::string& prefix){
+  statsPrefix = prefix;
+}
+
 void ParallelSim::getFilePaths(){
   // get paths for net and route files
   std::string cfgStr(cfgFile);
@@ -137,7 +238,10 @@ void ParallelSim::partitionNetwork(bool metis){
   if(metis) {
     pid_t pid;
     int status;
-    const char* args[6] = {"python3", "convertToMetis.py", netFile.c_str(), std::to_string(numThreads).c_str(), NULL};
+    // keep the partition count string alive until execvp
+    std::string partCount = std::to_string(numThreads);
+    std::string outputDir = workDir.empty() ? "." : workDir;
+    const char* args[8] = {"python3", "convertToMetis.py", netFile.c_str(), partCount.c_str(), "--output-dir", outputDir.c_str(), NULL};
     switch(pid = fork()){
       case -1:
         // fork() has failed
@@ -183,9 +287,139 @@ void ParallelSim::partitionNetwork(bool metis){
     netconvertOption1 = "--keep-edges.in-boundary";
   }
 
+  for(int i=0; i<numThreads; i++){
+    pid_t pid;
+    int status;
+    std::string charI = std::to_string(i);
+    std::string netPart = partPath("part"+charI+".net.xml");
+
+    std::string netconvertOption2;
+    if(metis)
+      netconvertOption2 = partPath("edgesPart"+charI);
+
+    else
+      netconvertOption2 = partBounds[i];
+
+    const char* partArgs[8] = {NETCONVERT_BINARY, netconvertOption1.c_str(), netconvertOption2.c_str(), "-s", netFile.c_str(), "-o", netPart.c_str(), NULL};
+    // create partition
+    switch(pid = fork()){
+      case -1:
+        // fork() has failed
+        perror("fork");
+        break;
+      case 0:
+        // execute netconvert to create sumo network partition
+        execv(partArgs[0], (char*const*) partArgs);
+        std::cout << "execv() has failed" << std::endl;
+        exit(EXIT_FAILURE);
+        break;
+      default:
+        // waiting for partition to be created
+        pid = wait(&status);
+        if(WEXITSTATUS(status)) {
+          std::cout << "Partition " << i << " failed to be created" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        printf("partition %d successfully created with status: %d\n", i, WEXITSTATUS(status));
+
+      }
+  }
+  if(haloDepth > 0)
+    buildHaloNets();
+  partitionRoutes();
+}
+
+std::unordered_set<std::string> ParallelSim::netEdges(const std::string& file){
+  std::unordered_set<std::string> edges;
+  tinyxml2::XMLDocument net;
+  tinyxml2::XMLError e = net.LoadFile(file.c_str());
+  if(e) {
+    std::cout << file << ": " << net.ErrorIDToName(e) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  tinyxml2::XMLElement* netEl = net.FirstChildElement("net");
+  for(tinyxml2::XMLElement* el = netEl->FirstChildElement("edge"); el != NULL; el = el->NextSiblingElement("edge")) {
+    if(el->Attribute("function") == nullptr || strcmp(el->Attribute("function"), "internal")!=0)
+      edges.insert(el->Attribute("id"));
+  }
+  return edges;
+}
+
+void ParallelSim::buildHaloNets(){
+  // edges at each junction of the original net
+  tinyxml2::XMLDocument network;
+  tinyxml2::XMLError e = network.LoadFile(netFile.c_str());
+  if(e) {
+    std::cout << network.ErrorIDToName(e) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::unordered_map<std::string, std::vector<std::string> > junctionEdges;
+  std::unordered_map<std::string, std::pair<std::string, std::string> > edgeEnds;
+  tinyxml2::XMLElement* netEl = network.FirstChildElement("net");
+  for(tinyxml2::XMLElement* el = netEl->FirstChildElement("edge"); el != NULL; el = el->NextSiblingElement("edge")) {
+    if(el->Attribute("function") != nullptr && strcmp(el->Attribute("function"), "internal")==0)
+      continue;
+    std::string from = el->Attribute("from");
+    std::string to = el->Attribute("to");
+    edgeEnds[el->Attribute("id")] = std::make_pair(from, to);
+    junctionEdges[from].push_back(el->Attribute("id"));
+    junctionEdges[to].push_back(el->Attribute("id"));
+  }
+
+  for(int i=0; i<numThreads; i++){
+    pid_t pid;
+    int status;
+    std::string charI = std::to_string(i);
+    // grow the partition's edges by one edge around its outer junctions per level
+    std::unordered_set<std::string> edges = netEdges(partPath("part"+charI+".net.xml"));
+    for(int level=0; level<haloDepth; level++) {
+      std::vector<std::string> added;
+      for(const std::string& edge : edges) {
+        std::pair<std::string, std::string>& ends = edgeEnds[edge];
+        for(const std::string& junction : {ends.first, ends.second}) {
+          for(std::string& next : junctionEdges[junction]) {
+            if(edges.find(next) == edges.end())
+              added.push_back(next);
+          }
+        }
+      }
+      edges.insert(added.begin(), added.end());
+    }
+    std::string edgesFile = partPath("haloEdgesPart"+charI);
+    std::ofstream out(edgesFile);
+    for(const std::string& edge : edges)
+      out << edge << "\n";
+    out.close();
+
+    std::string haloNet = partPath("part"+charI+".halo.net.xml");
+    const char* haloArgs[8] = {NETCONVERT_BINARY, "--keep-edges.input-file", edgesFile.c_str(), "-s", netFile.c_str(), "-o", haloNet.c_str(), NULL};
+    switch(pid = fork()){
+      case -1:
+        // fork() has failed
+        perror("fork");
+        break;
+      case 0:
+        // execute netconvert to create the partition net with its halo
+        execv(haloArgs[0], (char*const*) haloArgs);
+        std::cout << "execv() has failed" << std::endl;
+        exit(EXIT_FAILURE);
+        break;
+      default:
+        // waiting for halo net to be created
+        pid = wait(&status);
+        if(WEXITSTATUS(status)) {
+          std::cout << "Halo of partition " << i << " failed to be created" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        printf("halo %d successfully created with status: %d\n", i, WEXITSTATUS(status));
+    }
+  }
+}
+
+void ParallelSim::partitionRoutes(){
   // preprocess routes file for proper input to cutRoutes.py
   tinyxml2::XMLDocument routes;
-  e = routes.LoadFile(routeFile.c_str());
+  tinyxml2::XMLError e = routes.LoadFile(routeFile.c_str());
   if(e) {
     std::cout << routes.ErrorIDToName(e) << std::endl;
     exit(EXIT_FAILURE);
@@ -212,48 +446,30 @@ void ParallelSim::partitionNetwork(bool metis){
       count++;
     }
   }
-  routes.SaveFile("processed_routes");
+  std::string processedRoutes = partPath("processed_routes");
+  routes.SaveFile(processedRoutes.c_str());
 
+  // gui settings are referenced from the partition cfg, which may be in the work dir
+  std::string cfgPath = path;
+  if(!workDir.empty()) {
+    char* absPath = realpath(path.empty() ? "." : path.c_str(), NULL);
+    if(absPath != NULL) {
+      cfgPath = std::string(absPath)+"/";
+      free(absPath);
+    }
+  }
 
   for(int i=0; i<numThreads; i++){
     pid_t pid;
     int status;
     std::string charI = std::to_string(i);
-    std::string netPart = "part"+charI+".net.xml";
-    std::string rouPart = "part"+charI+".rou.xml";
-    std::string cfgPart = "part"+charI+".sumocfg";
+    // vehicles drive on into the halo, so their routes are cut to it
+    std::string netName = haloDepth > 0 ? "part"+charI+".halo.net.xml" : "part"+charI+".net.xml";
+    std::string netPart = partPath(netName);
+    std::string rouPart = partPath("part"+charI+".rou.xml");
+    std::string cfgPart = partPath("part"+charI+".sumocfg");
 
-    std::string netconvertOption2;
-    if(metis)
-      netconvertOption2 = "edgesPart"+charI;
-
-    else
-      netconvertOption2 = partBounds[i];
-
-    const char* partArgs[8] = {NETCONVERT_BINARY, netconvertOption1.c_str(), netconvertOption2.c_str(), "-s", netFile.c_str(), "-o", netPart.c_str(), NULL};
-    const char* rouArgs[11] = {"python3", "cutRoutes.py", netPart.c_str(), "processed_routes", "--routes-output", rouPart.c_str(), "--orig-net", netFile.c_str(), "--disconnected-action", "keep", NULL};
-    // create partition
-    switch(pid = fork()){
-      case -1:
-        // fork() has failed
-        perror("fork");
-        break;
-      case 0:
-        // execute netconvert to create sumo network partition
-        execv(partArgs[0], (char*const*) partArgs);
-        std::cout << "execv() has failed" << std::endl;
-        exit(EXIT_FAILURE);
-        break;
-      default:
-        // waiting for partition to be created
-        pid = wait(&status);
-        if(WEXITSTATUS(status)) {
-          std::cout << "Partition " << i << " failed to be created" << std::endl;
-          exit(EXIT_FAILURE);
-        }
-        printf("partition %d successfully created with status: %d\n", i, WEXITSTATUS(status));
-
-      }
+    const char* rouArgs[11] = {"python3", "cutRoutes.py", netPart.c_str(), processedRoutes.c_str(), "--routes-output", rouPart.c_str(), "--orig-net", netFile.c_str(), "--disconnected-action", "keep", NULL};
       // create routes for partition
       switch(pid = fork()){
         case -1:
@@ -281,35 +497,63 @@ void ParallelSim::partitionNetwork(bool metis){
         std::size_t size;
 
         int source = open(cfgFile, O_RDONLY, 0);
-        int dest = open(cfgPart.c_str(), O_WRONLY | O_CREAT, 0644);
+        int dest = open(cfgPart.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
         while((size = read(source, buf, BUFSIZ)) > 0){
           write(dest, buf, size);
         }
        close(source);
        close(dest);
-       // set partition net-file and route-files in cfg file
+       // set partition net-file and route-files in cfg file, relative to the cfg
+       std::string rouName = "part"+charI+".rou.xml";
        tinyxml2::XMLDocument cfgPartDoc;
        cfgPartDoc.LoadFile(cfgPart.c_str());
         tinyxml2::XMLElement* inputEl = cfgPartDoc.FirstChildElement("configuration")->FirstChildElement("input");
        tinyxml2::XMLElement* netFileEl = inputEl->FirstChildElement("net-file");
        tinyxml2::XMLElement* rouFileEl = inputEl->FirstChildElement("route-files");
        tinyxml2::XMLElement* guiFileEl = inputEl->FirstChildElement("gui-settings-file");
-       netFileEl->SetAttribute("value", netPart.c_str());
-       rouFileEl->SetAttribute("value", rouPart.c_str());
+       netFileEl->SetAttribute("value", netName.c_str());
+       rouFileEl->SetAttribute("value", rouName.c_str());
        if(guiFileEl != nullptr) {
-         std::string newGuiVal = path+guiFileEl->Attribute("value");
+         std::string newGuiVal = cfgPath+guiFileEl->Attribute("value");
          guiFileEl->SetAttribute("value", newGuiVal.c_str());
      }
        cfgPartDoc.SaveFile(cfgPart.c_str());
      }
 }
 
+void ParallelSim::setHaloEdges(std::vector<PartitionManager*>& parts){
+  std::vector<std::unordered_set<std::string> > cores;
+  for(int i=0; i<parts.size(); i++)
+    cores.push_back(netEdges(partPath("part"+std::to_string(i)+".net.xml")));
+  std::vector<std::vector<border_edge_t> > haloIn(parts.size()), haloOut(parts.size());
+  for(int i=0; i<parts.size(); i++) {
+    for(const std::string& edge : netEdges(partPath("part"+std::to_string(i)+".halo.net.xml"))) {
+      if(cores[i].find(edge) != cores[i].end())
+        continue;
+      // the lowest partition with the edge in its own net streams its vehicles
+      for(int owner=0; owner<parts.size(); owner++) {
+        if(cores[owner].find(edge) != cores[owner].end()) {
+          border_edge_t halo = {};
+          halo.id = edge;
+          halo.from = parts[owner];
+          halo.to = parts[i];
+          haloIn[i].push_back(halo);
+          haloOut[owner].push_back(halo);
+          break;
+        }
+      }
+    }
+  }
+  for(int i=0; i<parts.size(); i++)
+    parts[i]->setHaloEdges(haloIn[i], haloOut[i]);
+}
+
 void ParallelSim::setBorderEdges(std::vector<border_edge_t> borderEdges[], std::vector<PartitionManager*>& parts){
   std::unordered_multimap<std::string, int> allEdges;
   // add all edges to map, mapping edge ids to partition ids
   for(int i=0; i<parts.size(); i++) {
-    std::string currNetFile = "part"+std::to_string(i)+".net.xml";
+    std::string currNetFile = partPath("part"+std::to_string(i)+".net.xml");
     tinyxml2::XMLDocument currNet;
     tinyxml2::XMLError e = currNet.LoadFile(currNetFile.c_str());
     tinyxml2::XMLElement* netEl = currNet.FirstChildElement("net");
@@ -331,7 +575,7 @@ void ParallelSim::setBorderEdges(std::vector<border_edge_t> borderEdges[], std::
       border_edge_t borderEdge2 = {};
       borderEdge1.id = key;
       borderEdge2.id = key;
-      std::string currNetFile = "part"+std::to_string(edgeIt1->second)+".net.xml";
+      std::string currNetFile = partPath("part"+std::to_string(edgeIt1->second)+".net.xml");
       tinyxml2::XMLDocument currNet;
       tinyxml2::XMLError e = currNet.LoadFile(currNetFile.c_str());
       tinyxml2::XMLElement* netEl = currNet.FirstChildElement("net");
@@ -342,7 +586,13 @@ void ParallelSim::setBorderEdges(std::vector<border_edge_t> borderEdges[], std::
           for(tinyxml2::XMLElement* laneEl = el->FirstChildElement("lane"); laneEl != NULL; laneEl = laneEl->NextSiblingElement("lane")) {
             (borderEdge1.lanes).push_back(laneEl->Attribute("id"));
             (borderEdge2.lanes).push_back(laneEl->Attribute("id"));
+            borderEdge1.length = std::max(borderEdge1.length, laneEl->DoubleAttribute("length"));
+            borderEdge1.speed = std::max(borderEdge1.speed, laneEl->DoubleAttribute("speed"));
           }
+          borderEdge2.length = borderEdge1.length;
+          borderEdge2.speed = borderEdge1.speed;
+          borderEdge1.toJunction = el->Attribute("to");
+          borderEdge2.toJunction = borderEdge1.toJunction;
           // determine from and to partitions -  find junction to determine if dead end
           const char* fromJunc = el->Attribute("from");
           PartitionManager* from;
@@ -377,6 +627,33 @@ void ParallelSim::setBorderEdges(std::vector<border_edge_t> borderEdges[], std::
   }
 }
 
+double ParallelSim::borderLookahead(std::vector<border_edge_t>* borderEdges){
+  double lookahead = -1;
+  for(int i=0; i<numThreads; i++) {
+    for(border_edge_t& e : borderEdges[i]) {
+      if(e.speed <= 0)
+        continue;
+      double crossing = SyncScheduler::crossingTime(e.length, e.speed);
+      if(lookahead < 0 || crossing < lookahead)
+        lookahead = crossing;
+    }
+  }
+  return lookahead;
+}
+
+std::vector<std::vector<int> > ParallelSim::partitionGraph(std::vector<PartitionManager*>& parts){
+  std::vector<std::vector<int> > graph(parts.size());
+  for(int i=0; i<parts.size(); i++) {
+    std::cout << "partition " << i << " neighbours:";
+    for(PartitionManager* neighbour : parts[i]->getNeighbours()) {
+      graph[i].push_back(neighbour->getId());
+      std::cout << " " << neighbour->getId();
+    }
+    std::cout << std::endl;
+  }
+  return graph;
+}
+
 void ParallelSim::startSim(){
   std::string cfg;
   std::vector<PartitionManager*> parts;
@@ -385,34 +662,144 @@ void ParallelSim::startSim(){
   pthread_barrier_t barrier;
   pthread_cond_t cond;
 
+  std::string restartTime;
+  if(!restartDir.empty()) {
+    restartTime = PartitionManager::latestCheckpoint(restartDir);
+    if(restartTime.empty()) {
+      std::cout << "no complete checkpoint in " << restartDir << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "restarting from checkpoint at time " << restartTime << std::endl;
+  }
+
+  // a warm-up run stops at the warm-up time
+  int partEndTime = warmUpTime > 0 ? warmUpTime : endTime;
+
   // create partitions
   pthread_mutex_init(&lock, NULL);
   pthread_cond_init(&cond, NULL);
   pthread_barrier_init(&barrier, NULL, numThreads);
   for(int i=0; i<numThreads; i++) {
-    cfg = "part"+std::to_string(i)+".sumocfg";
-    PartitionManager* part = new PartitionManager(SUMO_BINARY, i, &barrier, &lock, &cond, cfg, host, port+i, endTime);
+    cfg = partPath("part"+std::to_string(i)+".sumocfg");
+    PartitionManager* part = new PartitionManager(SUMO_BINARY, i, &barrier, &lock, &cond, cfg, host, port+i, partEndTime);
+    part->setProfiling(traciProfiling);
+    if(!tripinfoPrefix.empty())
+      part->setTripinfoOutput(tripinfoPrefix+"_part"+std::to_string(i)+".xml");
+    if(checkpointInterval > 0)
+      part->setCheckpointing(checkpointDir, checkpointInterval);
+    if(warmUpTime > 0) {
+      part->setCheckpointing(warmUpDir, checkpointInterval);
+      part->setCheckpointAtEnd(true);
+    }
+    if(!restartDir.empty())
+      part->setRestart(restartDir, restartTime);
+    part->setSumoOptions(sumoOptions);
+    part->setContextSync(contextSync);
+    part->setRemovalDistance(removalDistance);
     parts.push_back(part);
   }
 
   setBorderEdges(borderEdges, parts);
-  // start parallel simulations
-  for(int i=0; i<numThreads; i++) {
+  if(haloDepth > 0)
+    setHaloEdges(parts);
+  // keep up to the last 2^20 events of each thread, buffers grow as they are recorded
+  if(!traceFile.empty())
+    TraceRecorder::enable(1 << 20);
+  MetricsServer* metrics = nullptr;
+  if(metricsPort > 0 || !metricsHost.compare(0, tcpip::Socket::unixPrefix.size(), tcpip::Socket::unixPrefix)) {
+    for(PartitionManager* part : parts)
+      part->setLiveMetrics(true);
+    metrics = new MetricsServer(metricsHost, metricsPort, parts);
+    if(!metrics->start())
+      std::cout << "unable to start metrics endpoint" << std::endl;
+  }
+  for(int i=0; i<numThreads; i++)
     parts[i]->setMyBorderEdges(borderEdges[i]);
-    if(!parts[i]->startPartition()){
-      printf("Error creating partition %d", i);
-      exit(EXIT_FAILURE);
+  // neighbour sync replaces the global sync rounds of the scheduler with per link ones
+  bool neighbourSync = barrierType == "neighbour" && eventWorkers == 0;
+  SyncScheduler* scheduler = nullptr;
+  if(adaptiveSync && eventWorkers > 0)
+    std::cout << "adaptive sync is not supported with event workers, synchronizing every step" << std::endl;
+  // halos are streamed at sync points, their ghosts would freeze between them
+  else if(adaptiveSync && haloDepth > 0 && !neighbourSync)
+    std::cout << "adaptive sync with halo edges needs the neighbour barrier, synchronizing every step" << std::endl;
+  else if(adaptiveSync && !neighbourSync) {
+    double lookahead = borderLookahead(borderEdges);
+    // without border edges the partitions never need to synchronize before the end
+    scheduler = new SyncScheduler(lookahead < 0 ? endTime : lookahead);
+    std::cout << "adaptive sync with a lookahead of " << lookahead << "s" << std::endl;
+    for(PartitionManager* part : parts)
+      part->setSyncScheduler(scheduler);
+  }
+  StepBarrier* stepBarrier = nullptr;
+  if(barrierType != "pthread" && eventWorkers == 0) {
+    stepBarrier = new StepBarrier(numThreads);
+    for(PartitionManager* part : parts)
+      part->setStepBarrier(stepBarrier);
+  }
+  if(neighbourSync) {
+    std::vector<std::vector<int> > graph = partitionGraph(parts);
+    for(int i=0; i<numThreads; i++) {
+      std::vector<PartitionManager*> neighbours;
+      for(int j : graph[i])
+        neighbours.push_back(parts[j]);
+      parts[i]->setNeighbourSync(neighbours, adaptiveSync);
     }
   }
-  // join all threads when finished executing
-  for (int i=0; i<numThreads; i++) {
-    parts[i]->waitForPartition();
+  if(workStealing && eventWorkers == 0)
+    std::cout << "work stealing needs event workers, running a thread per partition" << std::endl;
+  if(eventWorkers > 0 && workStealing) {
+    StealingExecutor executor(parts, eventWorkers);
+    executor.run();
+  }
+  else if(eventWorkers > 0) {
+    EventCoordinator coordinator(parts, eventWorkers);
+    coordinator.run();
+  }
+  else {
+    // start parallel simulations
+    for(int i=0; i<numThreads; i++) {
+      if(!parts[i]->startPartition()){
+        printf("Error creating partition %d", i);
+        exit(EXIT_FAILURE);
+      }
+    }
+    // join all threads when finished executing
+    for (int i=0; i<numThreads; i++) {
+      parts[i]->waitForPartition();
+    }
   }
 
+  delete metrics;
+  delete scheduler;
+  delete stepBarrier;
+  if(!traceFile.empty()) {
+    TraceRecorder::disable();
+    TraceRecorder::write(traceFile);
+    TraceRecorder::clear();
+  }
   pthread_cond_destroy(&cond);
   pthread_mutex_destroy(&lock);
   pthread_barrier_destroy(&barrier);
+  partStats.clear();
+  for(int i=0; i<numThreads; i++)
+    partStats.push_back(parts[i]->getStats());
+  if(!statsPrefix.empty()) {
+    std::vector<const PartitionStats*> stats;
+    for(int i=0; i<numThreads; i++)
+      stats.push_back(&partStats[i]);
+    PartitionStats::writeCSV(statsPrefix+".csv", stats);
+    PartitionStats::writeJSON(statsPrefix+".json", stats);
+  }
   for(int i=0; i<numThreads; i++) {
     delete parts[i];
   }
 }
+
+int ParallelSim::getEndTime(){
+  return endTime;
+}
+
+const std::vector<PartitionStats>& ParallelSim::getPartitionStats(){
+  return partStats;
+}
@@ -10,6 +10,7 @@ Author: Phillip Taylor
 #define PARALLELSIM_INCLUDED
 
 #include <cstdlib>
+#include <unordered_set>
 #include "TraCIAPI.h"
 #include "PartitionManager.h"
 
@@ -25,21 +26,106 @@ class ParallelSim {
     std::string netFile;
     std::string routeFile;
     int port;
+    std::string workDir;
+    int eventWorkers;
+    bool workStealing;
+    std::string statsPrefix;
+    std::vector<PartitionStats> partStats;
+    bool traciProfiling;
+    std::string metricsHost;
+    int metricsPort;
+    std::string traceFile;
+    std::string tripinfoPrefix;
+    std::string checkpointDir;
+    double checkpointInterval;
+    std::string restartDir;
+    std::string warmUpDir;
+    int warmUpTime;
+    std::vector<std::string> sumoOptions;
+    bool contextSync;
+    int haloDepth;
+    double removalDistance;
+    bool adaptiveSync;
+    std::string barrierType;
     int numThreads;
     int endTime;
+    // path of a partition file in the work dir
+    std::string partPath(const std::string&);
+    // non-internal edges of a net file
+    std::unordered_set<std::string> netEdges(const std::string&);
+    // build partition nets extended by haloDepth edges beyond their borders
+    void buildHaloNets();
+    // sets the halo edges of all partitions with the partitions owning them
+    void setHaloEdges(std::vector<PartitionManager*>&);
+    // shortest time a vehicle needs to cross any border edge (s)
+    double borderLookahead(std::vector<border_edge_t>*);
+    // partitions sharing border or halo edges with each partition
+    std::vector<std::vector<int> > partitionGraph(std::vector<PartitionManager*>&);
     // sets the border edges for all partitions
     void setBorderEdges(std::vector<border_edge_t>[], std::vector<PartitionManager*>&);
 
   public:
     // params: host, port, cfg file, gui (true), threads
     ParallelSim(const std::string&, int, const char*, bool, int);
+    // write and read partition files (nets, routes, cfgs) in given directory instead of the cwd
+    void setWorkDir(const std::string&);
+    // exits: the partitions' sumo servers only listen on tcp, unix domain sockets are left to tcpip::Socket users
+    void setUnixSockets(const std::string&);
+    // drive partitions from given number of event driven worker threads instead of a thread each
+    void setEventWorkers(int);
+    /* let the event workers take any partition whose neighbours are ready for its next step or
+       sync instead of a fixed share in lockstep, so there can be many more partitions than workers */
+    void setWorkStealing(bool);
+    // serve live prometheus metrics over http on given port, or unix socket if host is "unix:<path>"
+    void setMetricsEndpoint(const std::string&, int);
+    // write tripinfos of partition i to <prefix>_part<i>.xml and count teleports
+    void setTripinfoOutput(const std::string&);
+    // save a checkpoint of all partitions to <dir>/<time> every given simulation seconds
+    void setCheckpointing(const std::string&, double);
+    // resume startSim from the latest complete checkpoint in given directory
+    void restartFrom(const std::string&);
+    // run only until given time and save a checkpoint of all partitions there to given
+    // directory, from which variants can be started with restartFrom()
+    void warmUp(const std::string&, int);
+    // pass extra options to every partition's sumo, e.g. a seed or demand scale per variant
+    void setSumoOptions(const std::vector<std::string>&);
+    // read speeds on incoming border edges from context subscriptions on the border junctions
+    // and update each neighbour in one batch, instead of querying every vehicle
+    void setContextSync(bool);
+    // extend each partition's net by given number of edges beyond its border, the owner
+    // streams its vehicles on them into the neighbour every step (0 to disable)
+    void setHaloDepth(int);
+    /* remove the previous partition's copy of a handed off vehicle once it drove given metres
+       past the handoff position (or left the border edge), so it is simulated by one partition
+       only; negative keeps the copy until the end of its route part (default) */
+    void setRemovalDistance(double);
+    /* synchronize borders only every few steps, more while no border carries vehicles, at most
+       the time a vehicle needs to cross the shortest border edge (threaded engine only) */
+    void setAdaptiveSync(bool);
+    /* barrier for the step synchronization of the threaded engine: "pthread" (default),
+       "dissemination" (scales to many partitions, spins before blocking) or "neighbour"
+       (each pair of partitions sharing border edges synchronizes on its own, with adaptive
+       sync at an interval of its own) */
+    void setBarrier(const std::string&);
+    // record a chrome trace of partition events, written to given file at the end of startSim
+    void setTraceOutput(const std::string&);
+    // profile TraCI commands of each partition (traci_profile_part<i>.csv)
+    void setTraCIProfiling(bool);
+    // write per-partition phase timings to <prefix>.csv and <prefix>.json, empty to disable
+    void setStatsOutput(const std::string&);
     // gets network and route file paths
     void getFilePaths();
     // partition the SUMO network
     // param: true for metis partitioning, false for grid partitioning
     void partitionNetwork(bool);
+    // cut the routes for the partition nets already in the work dir and write partition cfgs
+    void partitionRoutes();
     // execute parallel sumo simulations in created partitions
     void startSim();
+    // simulation end time from the sumo cfg
+    int getEndTime();
+    // phase timings of each partition in the last startSim()
+    const std::vector<PartitionStats>& getPartitionStats();
 
 };
 
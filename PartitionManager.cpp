@@ -9,10 +9,24 @@ Author: Phillip Taylor
 
 
 #include <iostream>
+#include <fstream>
 #include <unistd.h>
 #include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <climits>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "TraCIAPI.h"
 #include "PartitionManager.h"
+#include "TraceRecorder.h"
+
+// sumo's defaults, only other modes are set on handed off vehicles
+static const int DEFAULT_SPEED_MODE = 31;
+static const int DEFAULT_LANE_CHANGE_MODE = 1621;
+// lane width assumed for the edge subscription range
+static const double LANE_WIDTH = 3.2;
 
 PartitionManager::PartitionManager(const char* binary, int id, pthread_barrier_t* barr,
   pthread_mutex_t* lock, pthread_cond_t* cond, std::string& cfg, std::string& host, int port, int t) :
@@ -35,6 +49,11 @@ void PartitionManager::setMyBorderEdges(std::vector<border_edge_t> borderEdges)
   }
 }
 
+void PartitionManager::setHaloEdges(const std::vector<border_edge_t>& in, const std::vector<border_edge_t>& out) {
+  haloInEdges = in;
+  haloOutEdges = out;
+}
+
 bool PartitionManager::startPartition() {
   return (pthread_create(&myThread, NULL, internalSimFunc, this) == 0);
 }
@@ -43,15 +62,440 @@ void PartitionManager::waitForPartition() {
   (void) pthread_join(myThread, NULL);
 }
 
-void PartitionManager::closePartition() {
+void PartitionManager::closeConnection() {
+  if(myConn.isProfiling()) {
+    std::vector<std::string> phaseNames;
+    for(int p=0; p<NUM_PHASES; p++)
+      phaseNames.push_back(PartitionStats::phaseName(p));
+    std::string file = "traci_profile_part"+std::to_string(id)+".csv";
+    std::ofstream out(file);
+    myConn.writeProfile(out, phaseNames);
+    std::cout << "partition " << id << " TraCI profile written to " << file << std::endl;
+  }
   myConn.close();
+  // sumo writes its outputs (e.g. tripinfos) before it exits, so they are complete once it is reaped
+  if(sumoPid > 0) {
+    metrics.sumoPid = -1;
+    waitpid(sumoPid, NULL, 0);
+    sumoPid = -1;
+  }
+}
+
+void PartitionManager::setProfiling(bool enabled) {
+  myConn.setProfiling(enabled);
+}
+
+void PartitionManager::setTripinfoOutput(const std::string& file) {
+  tripinfoFile = file;
+}
+
+void PartitionManager::setCheckpointing(const std::string& dir, double interval) {
+  checkpointDir = dir;
+  checkpointInterval = interval;
+}
+
+void PartitionManager::setCheckpointAtEnd(bool enabled) {
+  checkpointAtEnd = enabled;
+}
+
+void PartitionManager::setContextSync(bool enabled) {
+  contextSync = enabled;
+}
+
+void PartitionManager::setRemovalDistance(double distance) {
+  removalDistance = distance;
+}
+
+void PartitionManager::setSyncScheduler(SyncScheduler* s) {
+  scheduler = s;
+}
+
+bool PartitionManager::syncDue() {
+  if(scheduler == nullptr && !neighbourSync)
+    return true;
+  // the last step is always synchronized, checkpoints are saved by all partitions at the same step
+  if(simTime+deltaT >= endT || (checkpointInterval > 0 && simTime+deltaT >= nextCheckpoint))
+    return true;
+  return stepsToSync <= 1;
+}
+
+void PartitionManager::setStepBarrier(StepBarrier* barrier) {
+  stepBarrier = barrier;
+}
+
+void PartitionManager::setNeighbourSync(const std::vector<PartitionManager*>& neighbours, bool adaptive) {
+  neighbourSync = true;
+  adaptiveLinks = adaptive;
+  for(PartitionManager* neighbour : neighbours)
+    links[neighbour].id = neighbour->getId();
+}
+
+int PartitionManager::getId() {
+  return id;
+}
+
+std::vector<PartitionManager*> PartitionManager::getNeighbours() {
+  std::vector<PartitionManager*> neighbours;
+  std::vector<border_edge_t> edges = toBorderEdges;
+  edges.insert(edges.end(), fromBorderEdges.begin(), fromBorderEdges.end());
+  edges.insert(edges.end(), haloInEdges.begin(), haloInEdges.end());
+  edges.insert(edges.end(), haloOutEdges.begin(), haloOutEdges.end());
+  for(border_edge_t& e : edges) {
+    PartitionManager* other = e.from == this ? e.to : e.from;
+    if(std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end())
+      neighbours.push_back(other);
+  }
+  return neighbours;
+}
+
+void PartitionManager::setSumoOptions(const std::vector<std::string>& options) {
+  sumoOptions = options;
+}
+
+void PartitionManager::setRestart(const std::string& dir, const std::string& time) {
+  restartDir = dir;
+  restartTime = time;
+}
+
+bool PartitionManager::checkpointDue() {
+  if(isFinished())
+    return checkpointAtEnd;
+  return checkpointInterval > 0 && simTime >= nextCheckpoint;
+}
+
+void PartitionManager::saveCheckpoint() {
+  std::ostringstream time;
+  time << simTime;
+  std::string dir = checkpointDir+"/"+time.str();
+  mkdir(checkpointDir.c_str(), 0755);
+  mkdir(dir.c_str(), 0755);
+  std::string prefix = dir+"/part"+std::to_string(id);
+  myConn.simulation.saveState(prefix+".state.xml");
+  saveBorders(prefix+".borders");
+  nextCheckpoint = simTime+checkpointInterval;
+}
+
+void PartitionManager::commitCheckpoint() {
+  if(id != 0)
+    return;
+  std::ostringstream time;
+  time << simTime;
+  // replace the marker in one step so a crash never leaves it half written
+  std::string latest = checkpointDir+"/latest";
+  {
+    std::ofstream out(latest+".tmp");
+    out << time.str() << std::endl;
+  }
+  rename((latest+".tmp").c_str(), latest.c_str());
+  std::cout << "checkpoint saved at time " << time.str() << std::endl;
+}
+
+std::string PartitionManager::latestCheckpoint(const std::string& dir) {
+  std::ifstream in(dir+"/latest");
+  std::string time;
+  in >> time;
+  return time;
+}
+
+void PartitionManager::saveBorders(const std::string& file) {
+  std::ofstream out(file);
+  out.precision(17);
+  out << simTime << "\n" << prevToVehicles.size() << " " << prevFromVehicles.size() << "\n";
+  for(std::vector<std::string>& vehs : prevToVehicles) {
+    out << vehs.size() << "\n";
+    for(std::string& veh : vehs)
+      out << veh << "\n";
+  }
+  for(std::vector<std::string>& vehs : prevFromVehicles) {
+    out << vehs.size() << "\n";
+    for(std::string& veh : vehs)
+      out << veh << "\n";
+  }
+  // the ghosts are part of the sumo state, the replica table is kept here
+  out << haloStreamed.size() << "\n";
+  for(auto& streamed : haloStreamed)
+    out << streamed.first->getId() << " " << streamed.second << "\n";
+  out << haloReplicas.size() << "\n";
+  for(auto& replicas : haloReplicas) {
+    out << replicas.first->getId() << " " << replicas.second.size() << "\n";
+    for(auto& replica : replicas.second)
+      out << replica.first << " " << replica.second << "\n";
+  }
+  // owner table and released vehicles, so copies are still removed and not synchronized after a restart
+  out << handedOff.size() << "\n";
+  for(auto& handoff : handedOff)
+    out << handoff.first << " " << handoff.second.owner->getId() << " " << handoff.second.edge << " " << handoff.second.removeAt << "\n";
+  out << released.size() << "\n";
+  for(const std::string& veh : released)
+    out << veh << "\n";
+  if(!out) {
+    std::cout << "partition " << id << " unable to write " << file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void PartitionManager::loadBorders(const std::string& file) {
+  std::ifstream in(file);
+  double time;
+  int toEdges, fromEdges;
+  if(!(in >> time >> toEdges >> fromEdges) || toEdges != prevToVehicles.size() || fromEdges != prevFromVehicles.size()) {
+    std::cout << "partition " << id << " checkpoint " << file << " does not match its border edges" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  for(int i=0; i<toEdges+fromEdges; i++) {
+    std::vector<std::string>& vehs = i < toEdges ? prevToVehicles[i] : prevFromVehicles[i-toEdges];
+    int count;
+    in >> count;
+    vehs.resize(count);
+    for(int j=0; j<count; j++)
+      in >> vehs[j];
+  }
+  int streams, owners;
+  in >> streams;
+  for(int i=0; i<streams; i++) {
+    int part;
+    bool streamed;
+    in >> part >> streamed;
+    haloStreamed[neighbour(part, file)] = streamed;
+  }
+  in >> owners;
+  for(int i=0; i<owners; i++) {
+    int part, count;
+    in >> part >> count;
+    std::unordered_map<std::string, std::string>& replicas = haloReplicas[neighbour(part, file)];
+    for(int j=0; j<count; j++) {
+      std::string replica, route;
+      in >> replica >> route;
+      replicas[replica] = route;
+    }
+  }
+  int handoffs, releases;
+  in >> handoffs;
+  for(int i=0; i<handoffs; i++) {
+    std::string veh;
+    int part;
+    handoff_t handoff;
+    in >> veh >> part >> handoff.edge >> handoff.removeAt;
+    handoff.owner = neighbour(part, file);
+    handedOff[veh] = handoff;
+  }
+  in >> releases;
+  for(int i=0; i<releases; i++) {
+    std::string veh;
+    in >> veh;
+    released.insert(veh);
+  }
+  if(!in) {
+    std::cout << "partition " << id << " unable to read " << file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+PartitionManager* PartitionManager::neighbour(int part, const std::string& file) {
+  for(PartitionManager* neighbour : getNeighbours()) {
+    if(neighbour->getId() == part)
+      return neighbour;
+  }
+  std::cout << "partition " << id << " checkpoint " << file << " names partition " << part << ", which is no neighbour" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void PartitionManager::closePartition() {
+  closeConnection();
   pthread_exit(NULL);
 }
 
+void PartitionManager::startServer() {
+  // keep the port string alive until execv
+  std::string portStr = std::to_string(port);
+  std::vector<const char*> args = {SUMO_BINARY, "-c", cfg.c_str(), "--remote-port", portStr.c_str(), "--start"};
+  if(!tripinfoFile.empty()) {
+    args.push_back("--tripinfo-output");
+    args.push_back(tripinfoFile.c_str());
+  }
+  std::string stateFile = restartDir+"/"+restartTime+"/part"+std::to_string(id)+".state.xml";
+  if(!restartDir.empty()) {
+    args.push_back("--load-state");
+    args.push_back(stateFile.c_str());
+    args.push_back("--begin");
+    args.push_back(restartTime.c_str());
+  }
+  for(std::string& option : sumoOptions)
+    args.push_back(option.c_str());
+  args.push_back(NULL);
+
+  switch(sumoPid = fork()){
+    case -1:
+      // fork() has failed
+      perror("fork");
+      break;
+    case 0:
+      // execute sumo simulation
+      execv(args[0], (char*const*) &args[0]);
+      std::cout << "execv() has failed" << std::endl;
+      exit(EXIT_FAILURE);
+      break;
+  }
+  metrics.sumoPid = sumoPid;
+}
+
 void PartitionManager::connect() {
   myConn.connect(host, port);
 }
 
+void PartitionManager::prepareSim() {
+  deltaT = myConn.simulation.getDeltaT();
+  simTime = myConn.simulation.getTime();
+  prevToVehicles.assign(toBorderEdges.size(), std::vector<std::string>());
+  currToVehicles.assign(toBorderEdges.size(), std::vector<std::string>());
+  prevFromVehicles.assign(fromBorderEdges.size(), std::vector<std::string>());
+  currFromVehicles.assign(fromBorderEdges.size(), std::vector<std::string>());
+  if(!restartDir.empty())
+    loadBorders(restartDir+"/"+restartTime+"/part"+std::to_string(id)+".borders");
+  if(contextSync)
+    subscribeBorderJunctions();
+  subscribeEdgeStates();
+  haloVehicles.assign(haloOutEdges.size(), std::vector<std::string>());
+  if(adaptiveLinks) {
+    // a link may wait as long as a vehicle needs to cross its shortest border edge
+    std::vector<border_edge_t> edges = toBorderEdges;
+    edges.insert(edges.end(), fromBorderEdges.begin(), fromBorderEdges.end());
+    std::map<PartitionManager*, double> lookahead;
+    for(border_edge_t& e : edges) {
+      PartitionManager* neighbour = e.from == this ? e.to : e.from;
+      if(e.speed <= 0)
+        continue;
+      double crossing = SyncScheduler::crossingTime(e.length, e.speed);
+      if(lookahead.find(neighbour) == lookahead.end() || crossing < lookahead[neighbour])
+        lookahead[neighbour] = crossing;
+    }
+    // links with only halo edges stream every step
+    for(auto& l : lookahead)
+      links[l.first].maxInterval = std::max(1, (int)(l.second/deltaT));
+  }
+  // replicas are inserted on a route over their current halo edge
+  for(border_edge_t& e : haloInEdges) {
+    try {
+      myConn.route.add("halo_"+e.id, std::vector<std::string>(1, e.id));
+    }
+    // a restarted sumo state already has the route
+    catch(libsumo::TraCIException&){}
+  }
+  nextCheckpoint = simTime+checkpointInterval;
+  metrics.simTime = simTime;
+  metrics.runStart = PartitionStats::now();
+}
+
+void PartitionManager::beginStep() {
+  stepStart = PartitionStats::now();
+  myConn.setProfilePhase(PHASE_STEP);
+  // border edges are only needed at sync points
+  syncStep = syncDue();
+  stepsInFlight = 1;
+  // the steps up to the sync step need nothing from sumo, so they are run in one call.
+  // Per step teleport counts would be lost, so not while they are recorded
+  if(!syncStep && tripinfoFile.empty()) {
+    int remaining = (int)std::ceil((endT-simTime)/deltaT-1e-6);
+    if(checkpointInterval > 0)
+      remaining = std::min(remaining, (int)std::ceil((nextCheckpoint-simTime)/deltaT-1e-6));
+    stepsInFlight = std::max(1, std::min(stepsToSync-1, remaining-1));
+  }
+  // sumo counts time in milliseconds, so it is tracked here instead of queried
+  stepTarget = std::round((simTime+stepsInFlight*deltaT)*1000)/1000;
+  // step and query all border edges in one round trip
+  stepFuture = myConn.asyncSimulationStep(stepsInFlight > 1 ? stepTarget : 0);
+  if(syncStep) {
+    queueEdgeVehicles(toBorderEdges, toFutures);
+    queueEdgeVehicles(fromBorderEdges, fromFutures);
+    queueEdgeVehicles(haloOutEdges, haloFutures);
+  }
+  else {
+    toFutures.clear();
+    fromFutures.clear();
+    haloFutures.clear();
+  }
+  if(liveMetrics)
+    vehicleCountFuture = myConn.asyncGetInt(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::ID_COUNT, "");
+  // teleports are compared against a serial run along with the tripinfos
+  if(!tripinfoFile.empty())
+    teleportFuture = myConn.asyncGetInt(libsumo::CMD_GET_SIM_VARIABLE, libsumo::VAR_TELEPORT_STARTING_VEHICLES_NUMBER, "");
+  myConn.sendQueued();
+}
+
+bool PartitionManager::finishStep(bool wait) {
+  if(!myConn.receiveQueued(wait))
+    return false;
+  stepFuture.get();
+  simTime = stepTarget;
+  stepIndex += stepsInFlight;
+  for(int i=0; i<toFutures.size(); i++)
+    currToVehicles[i] = toFutures[i].get();
+  for(int i=0; i<fromFutures.size(); i++)
+    currFromVehicles[i] = fromFutures[i].get();
+  for(int i=0; i<haloFutures.size(); i++)
+    haloVehicles[i] = haloFutures[i].get();
+  if(liveMetrics)
+    metrics.vehicles = vehicleCountFuture.get();
+  if(!tripinfoFile.empty())
+    stats.countTeleports(teleportFuture.get());
+  uint64_t stepTime = PartitionStats::now()-stepStart;
+  stats.record(PHASE_STEP, stepTime);
+  TraceRecorder::complete("step", id, stepStart, stepTime);
+  metrics.simTime = simTime;
+  metrics.steps += stepsInFlight;
+  return true;
+}
+
+void PartitionManager::synchronizeBorders() {
+  // time spent waiting on neighbours is recorded separately
+  uint64_t start = PartitionStats::now();
+  uint64_t spin = stats.getTotal(PHASE_SPIN_WAIT);
+  myConn.setProfilePhase(PHASE_TO_EDGES);
+  if(contextSync)
+    handleToEdgesContext();
+  else
+    handleToEdges();
+  myConn.setProfilePhase(PHASE_FROM_EDGES);
+  uint64_t mid = PartitionStats::now();
+  uint64_t midSpin = stats.getTotal(PHASE_SPIN_WAIT);
+  handleFromEdges();
+  if(!haloOutEdges.empty())
+    streamHalo();
+  myConn.setProfilePhase(-1);
+  uint64_t end = PartitionStats::now();
+  stats.record(PHASE_TO_EDGES, mid-start-(midSpin-spin));
+  stats.record(PHASE_FROM_EDGES, end-mid-(stats.getTotal(PHASE_SPIN_WAIT)-midSpin));
+  // trace events nest, so they include the waits
+  TraceRecorder::complete("to_edges", id, start, mid-start);
+  TraceRecorder::complete("from_edges", id, mid, end-mid);
+}
+
+bool PartitionManager::isFinished() {
+  return simTime >= endT;
+}
+
+PartitionStats& PartitionManager::getStats() {
+  return stats;
+}
+
+void PartitionManager::recordBarrier(uint64_t start, uint64_t end) {
+  stats.record(PHASE_BARRIER, end-start);
+  metrics.barrierWaitNs += end-start;
+  TraceRecorder::complete("barrier", id, start, end-start);
+}
+
+void PartitionManager::setLiveMetrics(bool enabled) {
+  liveMetrics = enabled;
+}
+
+const partition_metrics_t& PartitionManager::getMetrics() {
+  return metrics;
+}
+
+int PartitionManager::getSocket() {
+  return myConn.getSocketDescriptor();
+}
+
 std::vector<std::string> PartitionManager::getEdgeVehicles(const std::string& edgeID) {
   return myConn.edge.getLastStepVehicleIDs(edgeID);
 }
@@ -60,23 +504,185 @@ std::vector<std::string> PartitionManager::getRouteEdges(const std::string& rout
   return myConn.route.getEdges(routeID);
 }
 
-void PartitionManager::add(const std::string& vehID, const std::string& routeID, const std::string& typeID,
- const std::string& laneInd, const std::string& depPos, const std::string& speed) {
-  myConn.vehicle.add(vehID, routeID, typeID, "-1", laneInd, depPos, speed);
+void PartitionManager::addVehicles(const std::string& edgeID, std::vector<vehicle_state_t>& vehs) {
+  // called from the previous partition's from edge phase
+  int phase = myConn.getProfilePhase();
+  myConn.setProfilePhase(PHASE_FROM_EDGES);
+  // check if vehicle not already on edge (if a vehicle starts on a border edge)
+  std::vector<std::string> edgeVehs = getEdgeVehicles(edgeID);
+  std::vector<std::future<void> > added, moved, updated;
+  std::string depart = std::to_string(simTime);
+  for(vehicle_state_t& veh : vehs) {
+    if(std::find(edgeVehs.begin(), edgeVehs.end(), veh.id) != edgeVehs.end())
+      continue;
+    // check if vehicle is on split route
+    int pos = veh.id.find("_part");
+    if(pos != std::string::npos) {
+      int routePos = veh.route.find("_part");
+      veh.route = partRoute(veh.route.substr(0,routePos+5), edgeID);
+    }
+    added.push_back(myConn.vehicle.asyncAdd(veh.id, veh.route, veh.type, depart,
+      std::to_string(veh.laneIndex), std::to_string(veh.lanePos), std::to_string(veh.speed)));
+    // move vehicle to proper lane position
+    moved.push_back(myConn.vehicle.asyncMoveTo(veh.id, veh.laneID, veh.lanePos));
+    // the speed factor is drawn again on insertion
+    updated.push_back(myConn.vehicle.asyncSetSpeedFactor(veh.id, veh.speedFactor));
+    if(veh.speedMode != DEFAULT_SPEED_MODE)
+      updated.push_back(myConn.vehicle.asyncSetSpeedMode(veh.id, veh.speedMode));
+    if(veh.laneChangeMode != DEFAULT_LANE_CHANGE_MODE)
+      updated.push_back(myConn.vehicle.asyncSetLaneChangeMode(veh.id, veh.laneChangeMode));
+  }
+  myConn.flush();
+  // vehicles that could not be added are lost at the border
+  int failed = 0;
+  for(std::future<void>& f : added) {
+    try {
+      f.get();
+    }
+    catch(libsumo::TraCIException&){
+      failed++;
+    }
+  }
+  for(std::future<void>& f : moved) {
+    try {
+      f.get();
+    }
+    catch(libsumo::TraCIException&){}
+  }
+  for(std::future<void>& f : updated) {
+    try {
+      f.get();
+    }
+    catch(libsumo::TraCIException&){}
+  }
+  stats.countFailedAdds(failed);
+  myConn.setProfilePhase(phase);
 }
 
-void PartitionManager::moveTo(const std::string& vehID, const std::string& laneID, double pos) {
-  myConn.vehicle.moveTo(vehID, laneID, pos);
+std::string PartitionManager::partRoute(const std::string& routeSub, const std::string& edgeID) {
+  for(int routePart=0;; routePart++) {
+    std::string route = routeSub+std::to_string(routePart);
+    auto cached = routeEdges.find(route);
+    if(cached == routeEdges.end())
+      cached = routeEdges.insert(std::make_pair(route, getRouteEdges(route))).first;
+    std::vector<std::string>& edges = cached->second;
+    auto it = std::find(edges.begin(), edges.end(), edgeID);
+    if(it == edges.begin())
+      return route;
+    if(it != edges.end()) {
+      // with halo edges the part starts before the border, enter it at the border edge
+      std::string trimmed = route+"_from_"+edgeID;
+      if(routeEdges.find(trimmed) == routeEdges.end()) {
+        std::vector<std::string> rest(it, edges.end());
+        try {
+          myConn.route.add(trimmed, rest);
+        }
+        // a restarted sumo state already has the route
+        catch(libsumo::TraCIException&){}
+        routeEdges[trimmed] = rest;
+      }
+      return trimmed;
+    }
+  }
 }
 
-void PartitionManager::slowDown(const std::string& vehID, double speed) {
-  myConn.vehicle.slowDown(vehID, speed, myConn.simulation.getDeltaT());
+void PartitionManager::updateHalo(PartitionManager* owner, const std::vector<vehicle_state_t>& vehs) {
+  // called from the owner's from edge phase
+  int phase = myConn.getProfilePhase();
+  myConn.setProfilePhase(PHASE_FROM_EDGES);
+  std::unordered_map<std::string, std::string>& replicas = haloReplicas[owner];
+  std::unordered_map<std::string, std::string> current;
+  std::vector<std::string> ids;
+  std::vector<std::future<void> > moved, updated;
+  std::string depart = std::to_string(simTime);
+  for(const vehicle_state_t& veh : vehs) {
+    // vehicles handed off from here still drive on in the halo and are only corrected
+    bool own = handedOff.find(veh.id) != handedOff.end();
+    std::string replica = own ? veh.id : "ghost_"+veh.id;
+    auto it = replicas.find(replica);
+    if(!own && (it == replicas.end() || it->second != veh.route)) {
+      // ghosts only have a route over their current edge, so they are re-inserted on a new one
+      if(it != replicas.end())
+        updated.push_back(myConn.vehicle.asyncRemove(replica));
+      updated.push_back(myConn.vehicle.asyncAdd(replica, veh.route, veh.type, depart,
+        std::to_string(veh.laneIndex), std::to_string(veh.lanePos), std::to_string(veh.speed)));
+    }
+    moved.push_back(myConn.vehicle.asyncMoveTo(replica, veh.laneID, veh.lanePos));
+    updated.push_back(myConn.vehicle.asyncSetSpeed(replica, veh.speed));
+    ids.push_back(replica);
+    current[replica] = veh.route;
+  }
+  // ghosts that left the owner's edges are removed, own vehicles finish their route
+  for(auto& replica : replicas) {
+    if(current.find(replica.first) != current.end())
+      continue;
+    auto own = handedOff.find(replica.first);
+    if(own == handedOff.end()) {
+      updated.push_back(myConn.vehicle.asyncRemove(replica.first));
+      continue;
+    }
+    // own vehicles drive on at their own speed, the owner table removes them if a distance is set
+    updated.push_back(myConn.vehicle.asyncSetSpeed(replica.first, -1));
+    if(removalDistance < 0)
+      handedOff.erase(own);
+  }
+  myConn.flush();
+  for(std::future<void>& f : updated) {
+    try {
+      f.get();
+    }
+    catch(libsumo::TraCIException&){}
+  }
+  // vehicles that could not be moved have arrived, ghosts are inserted again if still streamed
+  for(int i=0; i<moved.size(); i++) {
+    try {
+      moved[i].get();
+    }
+    catch(libsumo::TraCIException&){
+      current.erase(ids[i]);
+      handedOff.erase(ids[i]);
+    }
+  }
+  replicas.swap(current);
+  myConn.setProfilePhase(phase);
+}
+
+void PartitionManager::slowDown(const std::vector<speed_sync_t>& syncs) {
+  // called from the next partition's to edge phase
+  int phase = myConn.getProfilePhase();
+  myConn.setProfilePhase(PHASE_TO_EDGES);
+  // check if vehicle has been transferred out of partition
+  std::vector<std::future<std::vector<std::string> > > edgeFutures;
+  for(const speed_sync_t& sync : syncs)
+    edgeFutures.push_back(myConn.asyncGetStringVector(libsumo::CMD_GET_EDGE_VARIABLE, libsumo::LAST_STEP_VEHICLE_ID_LIST, sync.edge));
+  myConn.flush();
+  std::vector<std::future<void> > slowed;
+  for(int e=0; e<syncs.size(); e++) {
+    std::vector<std::string> edgeVehs = edgeFutures[e].get();
+    const speed_sync_t& sync = syncs[e];
+    for(int i=0; i<sync.vehIDs.size(); i++) {
+      if(std::find(edgeVehs.begin(), edgeVehs.end(), sync.vehIDs[i]) != edgeVehs.end())
+        slowed.push_back(myConn.vehicle.asyncSlowDown(sync.vehIDs[i], sync.speeds[i], deltaT));
+    }
+  }
+  myConn.flush();
+  for(std::future<void>& f : slowed) {
+    try {
+      f.get();
+    }
+    catch(libsumo::TraCIException&){}
+  }
+  myConn.setProfilePhase(phase);
 }
 
 void PartitionManager::setSynching(bool b) {
   synching = b;
 }
 
+void PartitionManager::setWaiting(bool b) {
+  waiting = b;
+}
+
 bool PartitionManager::isSynching() {
   return synching;
 }
@@ -95,138 +701,444 @@ void PartitionManager::waitForSynch() {
   pthread_mutex_unlock(lockAddr);
 }
 
-void PartitionManager::handleToEdges(int num, std::vector<std::string> prevToVehicles[]) {
-  for(int i=0; i<num;i++) {
-    pthread_mutex_lock(lockAddr);
-    std::vector<std::string> currVehicles = getEdgeVehicles(toBorderEdges[i].id);
-    pthread_mutex_unlock(lockAddr);
+void PartitionManager::queueEdgeVehicles(std::vector<border_edge_t>& edges, std::vector<std::future<std::vector<std::string> > >& vehs) {
+  vehs.clear();
+  for(border_edge_t& e : edges)
+    vehs.push_back(myConn.asyncGetStringVector(libsumo::CMD_GET_EDGE_VARIABLE, libsumo::LAST_STEP_VEHICLE_ID_LIST, e.id));
+}
 
-    if(!currVehicles.empty()) {
-      for(std::string veh : currVehicles) {
-        auto it = std::find(prevToVehicles[i].begin(), prevToVehicles[i].end(), veh);
-        // vehicle speed is to be updated in previous partition
-        if(it != prevToVehicles[i].end()) {
-          PartitionManager* fromPart = toBorderEdges[i].from;
-
-          // handle case where partitions update each other (e.g. two-way road)
-          if(synching)
-            waitForSynch();
-
-          fromPart->setSynching(true);
-          while(!fromPart->isWaiting()) {
-            // make sure partitions aren't waiting for each other
-            if(synching)
-              break;
-          }
-          pthread_mutex_lock(lockAddr);
+void PartitionManager::subscribeBorderJunctions() {
+  // one subscription per junction, reaching the far end of its longest border edge
+  std::vector<std::string> junctions;
+  std::vector<double> ranges;
+  for(border_edge_t& e : toBorderEdges) {
+    auto it = std::find(junctions.begin(), junctions.end(), e.toJunction);
+    if(it == junctions.end()) {
+      junctions.push_back(e.toJunction);
+      ranges.push_back(e.length);
+    }
+    else if(e.length > ranges[it-junctions.begin()])
+      ranges[it-junctions.begin()] = e.length;
+  }
+  myConn.setSubscriptionStore(true);
+  std::vector<int> vars = {libsumo::VAR_SPEED, libsumo::VAR_ROAD_ID};
+  for(int i=0; i<junctions.size(); i++)
+    myConn.junction.subscribeContext(junctions[i], libsumo::CMD_GET_VEHICLE_VARIABLE, ranges[i]+1,
+      vars, libsumo::INVALID_DOUBLE_VALUE, libsumo::INVALID_DOUBLE_VALUE);
+}
 
-          // check if vehicle has been transferred out of partition
-          std::vector<std::string> trans = fromPart->getEdgeVehicles(toBorderEdges[i].id);
-          if(std::find(trans.begin(), trans.end(), veh) != trans.end()) {
-            // set from partition vehicle speed to next partition vehicle speed
-            try {
-              fromPart->slowDown(veh, myConn.vehicle.getSpeed(veh));
-            }
-            catch(libsumo::TraCIException){}
+void PartitionManager::subscribeEdgeStates() {
+  std::vector<border_edge_t> edges = fromBorderEdges;
+  edges.insert(edges.end(), haloOutEdges.begin(), haloOutEdges.end());
+  if(edges.empty())
+    return;
+  myConn.setSubscriptionStore(true);
+  std::vector<int> vars = {libsumo::VAR_ROAD_ID, libsumo::VAR_ROUTE_ID, libsumo::VAR_TYPE, libsumo::VAR_LANE_ID,
+    libsumo::VAR_LANE_INDEX, libsumo::VAR_LANEPOSITION, libsumo::VAR_SPEED, libsumo::VAR_SPEED_FACTOR,
+    libsumo::VAR_SPEEDSETMODE, libsumo::VAR_LANECHANGE_MODE};
+  for(border_edge_t& e : edges) {
+    // the range reaches the outer lanes, vehicles of other edges are told apart by their road
+    double range = LANE_WIDTH*std::max<std::size_t>(1, e.lanes.size());
+    myConn.edge.subscribeContext(e.id, libsumo::CMD_GET_VEHICLE_VARIABLE, range, vars,
+      libsumo::INVALID_DOUBLE_VALUE, libsumo::INVALID_DOUBLE_VALUE);
+  }
+}
 
-          }
+void PartitionManager::gatherStates(const std::string& edgeID, const std::vector<std::string>& vehs,
+    std::vector<vehicle_state_t>& states, std::vector<std::string>& missed) {
+  const TraCIAPI::SubscriptionStore& store = myConn.edge.getContextSubscriptionStore();
+  for(const std::string& veh : vehs) {
+    int slot = store.getSlot(veh);
+    if(slot < 0 || store.getString(slot, libsumo::VAR_ROAD_ID) != edgeID) {
+      missed.push_back(veh);
+      continue;
+    }
+    vehicle_state_t state;
+    state.id = veh;
+    state.route = store.getString(slot, libsumo::VAR_ROUTE_ID);
+    state.type = store.getString(slot, libsumo::VAR_TYPE);
+    state.laneID = store.getString(slot, libsumo::VAR_LANE_ID);
+    state.laneIndex = store.getInt(slot, libsumo::VAR_LANE_INDEX);
+    state.lanePos = store.getDouble(slot, libsumo::VAR_LANEPOSITION);
+    state.speed = store.getDouble(slot, libsumo::VAR_SPEED);
+    state.speedFactor = store.getDouble(slot, libsumo::VAR_SPEED_FACTOR);
+    state.speedMode = store.getInt(slot, libsumo::VAR_SPEEDSETMODE);
+    state.laneChangeMode = store.getInt(slot, libsumo::VAR_LANECHANGE_MODE);
+    states.push_back(state);
+  }
+}
 
-          fromPart->setSynching(false);
-          pthread_mutex_unlock(lockAddr);
-          pthread_cond_signal(condAddr);
-        }
+void PartitionManager::queryStates(const std::vector<std::string>& missed, std::vector<vehicle_state_t>& states) {
+  if(missed.empty())
+    return;
+  // get the state of vehicles outside the subscriptions in one round trip
+  std::vector<std::future<std::string> > routes, types, lanes;
+  std::vector<std::future<int> > laneIndices, speedModes, laneChangeModes;
+  std::vector<std::future<double> > lanePositions, speeds, speedFactors;
+  for(const std::string& veh : missed) {
+    routes.push_back(myConn.asyncGetString(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_ROUTE_ID, veh));
+    types.push_back(myConn.asyncGetString(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_TYPE, veh));
+    lanes.push_back(myConn.asyncGetString(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_LANE_ID, veh));
+    laneIndices.push_back(myConn.asyncGetInt(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_LANE_INDEX, veh));
+    lanePositions.push_back(myConn.asyncGetDouble(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_LANEPOSITION, veh));
+    speeds.push_back(myConn.asyncGetDouble(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_SPEED, veh));
+    speedFactors.push_back(myConn.asyncGetDouble(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_SPEED_FACTOR, veh));
+    speedModes.push_back(myConn.asyncGetInt(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_SPEEDSETMODE, veh));
+    laneChangeModes.push_back(myConn.asyncGetInt(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_LANECHANGE_MODE, veh));
+  }
+  myConn.flush();
+  for(int j=0; j<missed.size(); j++) {
+    try {
+      vehicle_state_t state;
+      state.id = missed[j];
+      state.route = routes[j].get();
+      state.type = types[j].get();
+      state.laneID = lanes[j].get();
+      state.laneIndex = laneIndices[j].get();
+      state.lanePos = lanePositions[j].get();
+      state.speed = speeds[j].get();
+      state.speedFactor = speedFactors[j].get();
+      state.speedMode = speedModes[j].get();
+      state.laneChangeMode = laneChangeModes[j].get();
+      states.push_back(state);
+    }
+    catch(libsumo::TraCIException&){}
+  }
+}
+
+void PartitionManager::acquireNeighbour(PartitionManager* part) {
+  uint64_t spinStart = PartitionStats::now();
+
+  // handle case where partitions update each other (e.g. two-way road)
+  if(synching)
+    waitForSynch();
+
+  // make sure the neighbour is available to be updated
+  part->setSynching(true);
+  while(!part->isWaiting()) {
+    // make sure partitions aren't waiting for each other
+    if(synching)
+      break;
+  }
+  pthread_mutex_lock(lockAddr);
+  uint64_t spinTime = PartitionStats::now()-spinStart;
+  stats.record(PHASE_SPIN_WAIT, spinTime);
+  TraceRecorder::complete("synch_wait", id, spinStart, spinTime);
+}
+
+void PartitionManager::releaseNeighbour(PartitionManager* part) {
+  part->setSynching(false);
+  pthread_mutex_unlock(lockAddr);
+  pthread_cond_signal(condAddr);
+}
+
+void PartitionManager::handleToEdgesContext() {
+  const TraCIAPI::SubscriptionStore& store = myConn.junction.getContextSubscriptionStore();
+  // speeds for each previous partition, read from the last step response
+  std::vector<PartitionManager*> fromParts;
+  std::vector<std::vector<speed_sync_t> > batches;
+  // neighbours release vehicles while holding the lock
+  pthread_mutex_lock(lockAddr);
+  for(int i=0; i<toBorderEdges.size();i++) {
+    // borders with neighbours between sync points are left for later
+    if(!linkSyncing(toBorderEdges[i].from))
+      continue;
+    std::vector<std::string>& currVehicles = currToVehicles[i];
+    dropReleased(prevToVehicles[i], currVehicles);
+    if(currVehicles.empty())
+      continue;
+    speed_sync_t sync;
+    sync.edge = toBorderEdges[i].id;
+    for(std::string& veh : currVehicles) {
+      if(std::find(prevToVehicles[i].begin(), prevToVehicles[i].end(), veh) == prevToVehicles[i].end() ||
+          released.find(veh) != released.end())
+        continue;
+      int slot = store.getSlot(veh);
+      if(slot >= 0 && store.getString(slot, libsumo::VAR_ROAD_ID) == sync.edge) {
+        sync.vehIDs.push_back(veh);
+        sync.speeds.push_back(store.getDouble(slot, libsumo::VAR_SPEED));
       }
-      prevToVehicles[i] = currVehicles;
     }
+    prevToVehicles[i] = currVehicles;
+    if(sync.vehIDs.empty())
+      continue;
+    PartitionManager* fromPart = toBorderEdges[i].from;
+    auto it = std::find(fromParts.begin(), fromParts.end(), fromPart);
+    if(it == fromParts.end()) {
+      fromParts.push_back(fromPart);
+      batches.push_back(std::vector<speed_sync_t>());
+      it = fromParts.end()-1;
+    }
+    batches[it-fromParts.begin()].push_back(sync);
+  }
+  pthread_mutex_unlock(lockAddr);
+  for(int p=0; p<fromParts.size(); p++) {
+    acquireNeighbour(fromParts[p]);
+    fromParts[p]->slowDown(batches[p]);
+    int synched = 0;
+    for(speed_sync_t& sync : batches[p])
+      synched += sync.vehIDs.size();
+    stats.countSpeedSyncs(synched);
+    TraceRecorder::instant("speed_sync", id, PartitionStats::now(), synched);
+    releaseNeighbour(fromParts[p]);
   }
 }
 
-void PartitionManager::handleFromEdges(int num, std::vector<std::string> prevFromVehicles[]) {
-  for(int i=0; i<num;i++) {
+void PartitionManager::handleToEdges() {
+  for(int i=0; i<toBorderEdges.size();i++) {
+    if(!linkSyncing(toBorderEdges[i].from))
+      continue;
+    std::vector<std::string>& currVehicles = currToVehicles[i];
+    // vehicle speeds are to be updated in previous partition, unless it removed its copy.
+    // Neighbours release vehicles while holding the lock
+    std::vector<std::string> synched;
     pthread_mutex_lock(lockAddr);
-    std::vector<std::string> currVehicles = getEdgeVehicles(fromBorderEdges[i].id);
+    dropReleased(prevToVehicles[i], currVehicles);
+    for(std::string& veh : currVehicles) {
+      auto it = std::find(prevToVehicles[i].begin(), prevToVehicles[i].end(), veh);
+      if(it != prevToVehicles[i].end() && released.find(veh) == released.end())
+        synched.push_back(veh);
+    }
     pthread_mutex_unlock(lockAddr);
 
     if(!currVehicles.empty()) {
-      for(std::string veh : currVehicles) {
-        auto it = std::find(prevFromVehicles[i].begin(), prevFromVehicles[i].end(), veh);
-        // vehicle is to be inserted in next partition
-        if(it == prevFromVehicles[i].end()) {
-          PartitionManager* toPart = fromBorderEdges[i].to;
-
-          // handle case where partitions update each other (e.g. two-way road)
-          if(synching)
-            waitForSynch();
-
-          // make sure next partition is available to be updated
-          toPart->setSynching(true);
-          while(!toPart->isWaiting()) {
-            // make sure partitions aren't waiting for each other
-            if(synching)
-              break;
-          }
+      if(!synched.empty()) {
+        PartitionManager* fromPart = toBorderEdges[i].from;
+        acquireNeighbour(fromPart);
 
-          pthread_mutex_lock(lockAddr);
-
-
-          // check if vehicle not already on edge (if a vehicle starts on a border edge)
-          std::vector<std::string> toVehs = toPart->getEdgeVehicles(fromBorderEdges[i].id);
-          std::string route = myConn.vehicle.getRouteID(veh);
-
-          if(std::find(toVehs.begin(), toVehs.end(), veh) == toVehs.end()) {
-
-            // check if vehicle is on split route
-            int pos = veh.find("_part");
-            if(pos != std::string::npos) {
-              int routePos = route.find("_part");
-              std::string routeSub = route.substr(0,routePos+5);
-              route = routeSub+"0";
-              int routePart = 0;
-              std::string firstEdge = (toPart->getRouteEdges(route))[0];
-              while(firstEdge.compare(fromBorderEdges[i].id)) {
-                routePart++;
-                route = routeSub+std::to_string(routePart);
-                firstEdge = (toPart->getRouteEdges(route))[0];
-              }
-            }
-            try {
-              // add vehicle to next partition
-              toPart->add(veh, route, myConn.vehicle.getTypeID(veh),
-              std::to_string(myConn.vehicle.getLaneIndex(veh)), std::to_string(myConn.vehicle.getLanePosition(veh)),
-              std::to_string(myConn.vehicle.getSpeed(veh)));
-              // move vehicle to proper lane position in next partition
-              toPart->moveTo(veh, myConn.vehicle.getLaneID(veh), myConn.vehicle.getLanePosition(veh));
-            }
-            catch(libsumo::TraCIException){}
+        // get all speeds in one round trip
+        std::vector<std::future<double> > speedFutures;
+        for(std::string& veh : synched)
+          speedFutures.push_back(myConn.asyncGetDouble(libsumo::CMD_GET_VEHICLE_VARIABLE, libsumo::VAR_SPEED, veh));
+        myConn.flush();
+        std::vector<speed_sync_t> syncs(1);
+        syncs[0].edge = toBorderEdges[i].id;
+        for(int j=0; j<synched.size(); j++) {
+          try {
+            syncs[0].speeds.push_back(speedFutures[j].get());
+            syncs[0].vehIDs.push_back(synched[j]);
           }
-
-          toPart->setSynching(false);
-          pthread_mutex_unlock(lockAddr);
-          pthread_cond_signal(condAddr);
+          catch(libsumo::TraCIException&){}
         }
+        // set from partition vehicle speeds to next partition vehicle speeds
+        fromPart->slowDown(syncs);
+        stats.countSpeedSyncs(syncs[0].vehIDs.size());
+        TraceRecorder::instant("speed_sync", id, PartitionStats::now(), syncs[0].vehIDs.size());
+
+        releaseNeighbour(fromPart);
       }
+      prevToVehicles[i] = currVehicles;
+    }
+  }
+}
+
+void PartitionManager::handleFromEdges() {
+  std::vector<std::vector<std::string> > removed = removeHandedOff();
+  for(int i=0; i<fromBorderEdges.size();i++) {
+    if(!linkSyncing(fromBorderEdges[i].to))
+      continue;
+    std::vector<std::string>& currVehicles = currFromVehicles[i];
+
+    // vehicles are to be inserted in next partition
+    std::vector<std::string> transfers;
+    for(std::string& veh : currVehicles) {
+      auto it = std::find(prevFromVehicles[i].begin(), prevFromVehicles[i].end(), veh);
+      if(it == prevFromVehicles[i].end())
+        transfers.push_back(veh);
+    }
+    if(!currVehicles.empty())
       prevFromVehicles[i] = currVehicles;
+    if(transfers.empty() && removed[i].empty())
+      continue;
+
+    // the subscribed state is read before the neighbour is locked
+    std::vector<vehicle_state_t> vehs;
+    std::vector<std::string> missed;
+    if(!transfers.empty())
+      gatherStates(fromBorderEdges[i].id, transfers, vehs, missed);
+    PartitionManager* toPart = fromBorderEdges[i].to;
+    acquireNeighbour(toPart);
+    // the connection may only be used with the lock held
+    queryStates(missed, vehs);
+
+    // the next partition owns vehicles whose copy was removed here
+    if(!removed[i].empty())
+      toPart->releaseVehicles(removed[i]);
+    if(!transfers.empty()) {
+      // add vehicles to next partition
+      toPart->addVehicles(fromBorderEdges[i].id, vehs);
+      if(removalDistance >= 0 || !haloOutEdges.empty() || !haloInEdges.empty()) {
+        for(vehicle_state_t& veh : vehs) {
+          handoff_t handoff = {toPart, i, veh.lanePos+removalDistance};
+          handedOff[veh.id] = handoff;
+        }
+      }
+      stats.countHandoffs(vehs.size());
+      metrics.handoffs += vehs.size();
+      TraceRecorder::instant("handoff", id, PartitionStats::now(), vehs.size());
     }
+
+    releaseNeighbour(toPart);
   }
 }
 
+std::vector<std::vector<std::string> > PartitionManager::removeHandedOff() {
+  std::vector<std::vector<std::string> > removed(fromBorderEdges.size());
+  if(removalDistance < 0)
+    return removed;
+  // neighbours update handedOff and queue commands on this connection while holding the lock
+  pthread_mutex_lock(lockAddr);
+  const TraCIAPI::SubscriptionStore& store = myConn.edge.getContextSubscriptionStore();
+  bool halo = !haloInEdges.empty();
+  std::vector<std::future<void> > removing;
+  for(auto it = handedOff.begin(); it != handedOff.end();) {
+    handoff_t& handoff = it->second;
+    // the owner's flag may only be changed at a sync point of its link
+    if(!linkSyncing(handoff.owner)) {
+      ++it;
+      continue;
+    }
+    int slot = store.getSlot(it->first);
+    bool onEdge = slot >= 0 && store.getString(slot, libsumo::VAR_ROAD_ID) == fromBorderEdges[handoff.edge].id;
+    if(onEdge && store.getDouble(slot, libsumo::VAR_LANEPOSITION) < handoff.removeAt) {
+      ++it;
+      continue;
+    }
+    // without a halo a copy that left the border edge has reached the end of its route here
+    if(onEdge || halo) {
+      removing.push_back(myConn.vehicle.asyncRemove(it->first));
+      removed[handoff.edge].push_back(it->first);
+    }
+    it = handedOff.erase(it);
+  }
+  if(!removing.empty()) {
+    myConn.flush();
+    for(std::future<void>& f : removing) {
+      try {
+        f.get();
+      }
+      catch(libsumo::TraCIException&){}
+    }
+    TraceRecorder::instant("remove_copies", id, PartitionStats::now(), removing.size());
+  }
+  pthread_mutex_unlock(lockAddr);
+  return removed;
+}
 
-void PartitionManager::internalSim() {
-  pid_t pid;
-  const char* args[7] = {SUMO_BINARY, "-c", cfg.c_str(), "--remote-port", std::to_string(port).c_str(), "--start", NULL};
+void PartitionManager::releaseVehicles(const std::vector<std::string>& vehs) {
+  released.insert(vehs.begin(), vehs.end());
+}
 
-  switch(pid = fork()){
-    case -1:
-      // fork() has failed
-      perror("fork");
-      break;
-    case 0:
-      // execute sumo simulation
-      execv(args[0], (char*const*) args);
-      std::cout << "execv() has failed" << std::endl;
-      exit(EXIT_FAILURE);
-      break;
+void PartitionManager::dropReleased(const std::vector<std::string>& prevVehicles, const std::vector<std::string>& currVehicles) {
+  if(released.empty())
+    return;
+  for(const std::string& veh : prevVehicles) {
+    if(std::find(currVehicles.begin(), currVehicles.end(), veh) == currVehicles.end())
+      released.erase(veh);
+  }
+}
+
+bool PartitionManager::linkSyncing(PartitionManager* part) {
+  if(!neighbourSync)
+    return true;
+  auto it = links.find(part);
+  return it != links.end() && it->second.syncing;
+}
+
+int PartitionManager::linkVehicles(PartitionManager* part) {
+  int vehicles = 0;
+  for(int i=0; i<toBorderEdges.size(); i++) {
+    if(toBorderEdges[i].from == part)
+      vehicles += currToVehicles[i].size();
+  }
+  for(int i=0; i<fromBorderEdges.size(); i++) {
+    if(fromBorderEdges[i].to == part)
+      vehicles += currFromVehicles[i].size();
+  }
+  for(int i=0; i<haloOutEdges.size(); i++) {
+    if(haloOutEdges[i].to == part)
+      vehicles += haloVehicles[i].size();
+  }
+  return vehicles;
+}
+
+void PartitionManager::beginLinkSync() {
+  syncIds.clear();
+  for(auto& l : links) {
+    link_t& link = l.second;
+    link.syncing = link.nextStep <= stepIndex || isFinished();
+    if(!link.syncing)
+      continue;
+    link.vehicles = linkVehicles(l.first);
+    syncIds.push_back(link.id);
+  }
+  // neighbours must have stepped before their borders are touched
+  waiting = true;
+  uint64_t barrierStart = PartitionStats::now();
+  stepBarrier->waitNeighbours(id, 0, stepIndex, syncIds);
+  recordBarrier(barrierStart, PartitionStats::now());
+  waiting = false;
+  // a neighbour may have started updating this partition while it was waiting
+  if(synching)
+    waitForSynch();
+  // both ends see the same vehicles and intervals, so they agree on the next sync point
+  for(auto& l : links) {
+    link_t& link = l.second;
+    if(!link.syncing)
+      continue;
+    int vehicles = link.vehicles+l.first->links.find(this)->second.vehicles;
+    link.interval = adaptiveLinks ? SyncScheduler::adapt(link.interval, vehicles, link.maxInterval) : 1;
+    link.nextStep = stepIndex+link.interval;
   }
+}
+
+void PartitionManager::scheduleLinks() {
+  int64_t next = INT_MAX;
+  for(auto& l : links) {
+    l.second.syncing = false;
+    next = std::min(next, l.second.nextStep);
+  }
+  stepsToSync = (int)std::min<int64_t>(next-stepIndex, INT_MAX);
+}
+
+void PartitionManager::streamHalo() {
+  std::map<PartitionManager*, std::vector<vehicle_state_t> > streams;
+  // vehicles the subscriptions missed and their halo routes, queried once the neighbour is locked
+  std::map<PartitionManager*, std::vector<std::string> > missed;
+  std::unordered_map<std::string, std::string> missedRoutes;
+  for(int i=0; i<haloOutEdges.size(); i++) {
+    if(!linkSyncing(haloOutEdges[i].to))
+      continue;
+    std::vector<vehicle_state_t>& stream = streams[haloOutEdges[i].to];
+    std::vector<std::string>& streamMissed = missed[haloOutEdges[i].to];
+    std::size_t first = stream.size();
+    std::size_t firstMissed = streamMissed.size();
+    gatherStates(haloOutEdges[i].id, haloVehicles[i], stream, streamMissed);
+    for(std::size_t j=first; j<stream.size(); j++)
+      stream[j].route = "halo_"+haloOutEdges[i].id;
+    for(std::size_t j=firstMissed; j<streamMissed.size(); j++)
+      missedRoutes[streamMissed[j]] = "halo_"+haloOutEdges[i].id;
+  }
+  for(auto& stream : streams) {
+    std::vector<std::string>& streamMissed = missed[stream.first];
+    // an empty stream still clears the neighbour's ghosts once
+    bool& streamed = haloStreamed[stream.first];
+    if(stream.second.empty() && streamMissed.empty() && !streamed)
+      continue;
+    acquireNeighbour(stream.first);
+    std::size_t first = stream.second.size();
+    queryStates(streamMissed, stream.second);
+    for(std::size_t j=first; j<stream.second.size(); j++)
+      stream.second[j].route = missedRoutes[stream.second[j].id];
+    streamed = !stream.second.empty();
+    stream.first->updateHalo(this, stream.second);
+    TraceRecorder::instant("halo", id, PartitionStats::now(), stream.second.size());
+    releaseNeighbour(stream.first);
+  }
+}
+
+void PartitionManager::internalSim() {
+  startServer();
   // wait for server to startup (1 second)
   usleep(1000000);
   // ensure all servers have started before simulation begins
@@ -234,26 +1146,56 @@ void PartitionManager::internalSim() {
   connect();
   pthread_mutex_lock(lockAddr);
   std::cout << "partition " << id << " started in thread " << pthread_self() << std::endl;
+  prepareSim();
   pthread_mutex_unlock(lockAddr);
-  int numFromEdges = fromBorderEdges.size();
-  int numToEdges = toBorderEdges.size();
-  std::vector<std::string> prevToVehicles[numToEdges];
-  std::vector<std::string> prevFromVehicles[numFromEdges];
-  while(myConn.simulation.getTime() < endT) {
+  stats.startRun();
+  while(!isFinished()) {
     waiting = false;
     pthread_mutex_lock(lockAddr);
-    myConn.simulationStep();
+    beginStep();
+    finishStep(true);
     pthread_mutex_unlock(lockAddr);
+    // between sync points partitions step on independently
+    if(!syncStep) {
+      stepsToSync -= stepsInFlight;
+      continue;
+    }
+    if(neighbourSync)
+      beginLinkSync();
     // synchronize border edges
-    handleToEdges(numToEdges, prevToVehicles);
-  //  waiting = true;
-  //  pthread_barrier_wait(barrierAddr);
-  //  waiting = false;
-    handleFromEdges(numFromEdges, prevFromVehicles);
+    synchronizeBorders();
+    if(scheduler != nullptr) {
+      int vehicles = 0;
+      for(std::vector<std::string>& vehs : currToVehicles)
+        vehicles += vehs.size();
+      for(std::vector<std::string>& vehs : currFromVehicles)
+        vehicles += vehs.size();
+      scheduler->report(syncRound, vehicles);
+    }
 
     // make sure every time step across partitions is synchronized
     waiting = true;
-    pthread_barrier_wait(barrierAddr);
+    uint64_t barrierStart = PartitionStats::now();
+    if(stepBarrier == nullptr)
+      pthread_barrier_wait(barrierAddr);
+    else if(neighbourSync)
+      stepBarrier->waitNeighbours(id, 1, stepIndex, syncIds);
+    else
+      stepBarrier->wait(id);
+    recordBarrier(barrierStart, PartitionStats::now());
+    if(scheduler != nullptr) {
+      syncInterval = scheduler->nextInterval(syncRound++, syncInterval, deltaT);
+      stepsToSync = syncInterval;
+    }
+    else if(neighbourSync)
+      scheduleLinks();
+    if(checkpointDue()) {
+      saveCheckpoint();
+      // neighbours may only be changed again once every partition has saved
+      pthread_barrier_wait(barrierAddr);
+      commitCheckpoint();
+    }
   }
+  stats.endRun();
   closePartition();
 }
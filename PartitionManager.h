@@ -12,9 +12,30 @@ Author: Phillip Taylor
 
 #include <cstdlib>
 #include <pthread.h>
+#include <atomic>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include "Pthread_barrier.h"
+#include "PartitionStats.h"
+#include "SyncScheduler.h"
+#include "StepBarrier.h"
 
 typedef struct border_edge_t border_edge_t;
+typedef struct vehicle_state_t vehicle_state_t;
+typedef struct speed_sync_t speed_sync_t;
+typedef struct handoff_t handoff_t;
+
+// progress of a partition, read by the metrics endpoint without locking
+struct partition_metrics_t {
+    std::atomic<double> simTime{0};
+    std::atomic<uint64_t> steps{0};
+    std::atomic<int> vehicles{0};
+    std::atomic<uint64_t> handoffs{0};
+    std::atomic<uint64_t> barrierWaitNs{0};
+    std::atomic<uint64_t> runStart{0};
+    std::atomic<int> sumoPid{-1};
+};
 
 class PartitionManager {
   private:
@@ -26,6 +47,8 @@ class PartitionManager {
     std::string host;
     int port;
     int endT;
+    double simTime = 0;
+    double deltaT = 0;
     bool synching = false;
     bool waiting = false;
     pthread_t myThread;
@@ -33,15 +56,135 @@ class PartitionManager {
     pthread_mutex_t* lockAddr;
     pthread_cond_t* condAddr;
     TraCIAPI myConn;
+    pid_t sumoPid = -1;
+    PartitionStats stats;
+    uint64_t stepStart = 0;
+    partition_metrics_t metrics;
+    bool liveMetrics = false;
+    std::future<int> vehicleCountFuture;
+    std::string tripinfoFile;
+    std::future<int> teleportFuture;
+    // checkpoints are saved to checkpointDir/<time> every checkpointInterval seconds
+    std::string checkpointDir;
+    double checkpointInterval = 0;
+    double nextCheckpoint = 0;
+    // also save a checkpoint at the end time (warm-up runs)
+    bool checkpointAtEnd = false;
+    // extra options for this partition's sumo
+    std::vector<std::string> sumoOptions;
+    // read incoming border vehicle speeds from context subscriptions on the border junctions
+    bool contextSync = false;
+    // checkpoint to resume from
+    std::string restartDir;
+    std::string restartTime;
+    // vehicles on each border edge in the previous and current step
+    std::vector<std::vector<std::string> > prevToVehicles;
+    std::vector<std::vector<std::string> > prevFromVehicles;
+    std::vector<std::vector<std::string> > currToVehicles;
+    std::vector<std::vector<std::string> > currFromVehicles;
+    // responses of the step in flight
+    std::future<void> stepFuture;
+    // steps sent with the last step command and the time they end at
+    int stepsInFlight = 1;
+    double stepTarget = 0;
+    std::vector<std::future<std::vector<std::string> > > toFutures;
+    std::vector<std::future<std::vector<std::string> > > fromFutures;
+    // halo edges replicated from their owners, and own edges in the neighbours' halos
+    std::vector<border_edge_t> haloInEdges;
+    std::vector<border_edge_t> haloOutEdges;
+    std::vector<std::future<std::vector<std::string> > > haloFutures;
+    std::vector<std::vector<std::string> > haloVehicles;
+    // neighbours streamed to in the last step
+    std::map<PartitionManager*, bool> haloStreamed;
+    // replicas of each owner's halo vehicles with their edge
+    std::map<PartitionManager*, std::unordered_map<std::string, std::string> > haloReplicas;
+    // owner table of vehicles handed to a neighbour whose copy is still simulated here
+    std::unordered_map<std::string, handoff_t> handedOff;
+    // vehicles on incoming border edges whose copy in the previous partition was removed
+    std::unordered_set<std::string> released;
+    // distance past the handoff position at which the copy is removed, negative to keep it
+    double removalDistance = -1;
+    // shared schedule of sync points, every step is synchronized without one
+    SyncScheduler* scheduler = nullptr;
+    int syncRound = 0;
+    int syncInterval = 1;
+    int stepsToSync = 1;
+    // the step in flight ends at a sync point
+    bool syncStep = true;
+    // step barrier replacing the pthread barrier
+    StepBarrier* stepBarrier = nullptr;
+    // a link to a neighbour in the partition graph, synchronized at its own sync points
+    struct link_t {
+      int id = -1;
+      // longest and current interval in steps, and the step of the next sync point
+      int maxInterval = 1;
+      int interval = 1;
+      int64_t nextStep = 1;
+      bool syncing = false;
+      // border vehicles of the link at its last sync point, read by the neighbour
+      std::atomic<int> vehicles{0};
+    };
+    // synchronize point-to-point with the neighbours only, adapting each link's interval
+    bool neighbourSync = false;
+    bool adaptiveLinks = false;
+    std::map<PartitionManager*, link_t> links;
+    // neighbours synchronized in the current round
+    std::vector<int> syncIds;
+    // steps simulated since the start
+    int64_t stepIndex = 0;
+    // edges of the routes vehicles were added on
+    std::unordered_map<std::string, std::vector<std::string> > routeEdges;
     // thread helper function
     static void * internalSimFunc(void* This){
       ((PartitionManager*)This)->internalSim();
       return NULL;
     }
+    // queue requests for the vehicles on each of the given border edges
+    void queueEdgeVehicles(std::vector<border_edge_t>&, std::vector<std::future<std::vector<std::string> > >&);
+    // write or read the border vehicles of the previous step, the halo replica table,
+    // the owner table and the released vehicles
+    void saveBorders(const std::string&);
+    void loadBorders(const std::string&);
+    // neighbour with given id named in given checkpoint file
+    PartitionManager* neighbour(int, const std::string&);
+    // subscribe to the vehicles around the junctions the incoming border edges lead to
+    void subscribeBorderJunctions();
+    // subscribe to the state of the vehicles on outgoing border and halo edges
+    void subscribeEdgeStates();
+    /* state of the given vehicles on given edge from the edge subscriptions, adding
+       the vehicles they missed to the last param */
+    void gatherStates(const std::string&, const std::vector<std::string>&, std::vector<vehicle_state_t>&,
+      std::vector<std::string>&);
+    // state of vehicles the subscriptions missed in one round trip, only with the lock held
+    void queryStates(const std::vector<std::string>&, std::vector<vehicle_state_t>&);
+    // wait until the neighbour can be updated and take the lock, then release it again
+    void acquireNeighbour(PartitionManager*);
+    void releaseNeighbour(PartitionManager*);
     // handle border edges where vehicles are incoming
-    void handleToEdges(int, std::vector<std::string>[]);
+    void handleToEdges();
+    // handle incoming border edges with speeds from the junction subscriptions,
+    // updating each previous partition in one batch
+    void handleToEdgesContext();
     // handle border edges where vehicles are outgoing
-    void handleFromEdges(int, std::vector<std::string>[]);
+    void handleFromEdges();
+    /* remove handed off copies that reached their removal point, in one round trip under
+       the lock. Returns the removed vehicles of each outgoing border edge */
+    std::vector<std::vector<std::string> > removeHandedOff();
+    // forget released vehicles that left an incoming border edge, with the lock held
+    void dropReleased(const std::vector<std::string>&, const std::vector<std::string>&);
+    // return true if the borders with given neighbour are synchronized in this round
+    bool linkSyncing(PartitionManager*);
+    // vehicles on the border and halo edges shared with given neighbour
+    int linkVehicles(PartitionManager*);
+    /* start a sync round with the links due at the current step: wait until their
+       neighbours have stepped and agree on each link's next sync point */
+    void beginLinkSync();
+    // steps until the next sync point of any link
+    void scheduleLinks();
+    // send the state of vehicles on own edges to the neighbours holding them as halo
+    void streamHalo();
+    // route part of given split route prefix entering this partition on given edge
+    std::string partRoute(const std::string&, const std::string&);
 
   protected:
     // start sumo simulation in thread
@@ -53,32 +196,103 @@ public:
      pthread_cond_t*, std::string&, std::string&, int, int);
   // set this partition's border edges
    void setMyBorderEdges(std::vector<border_edge_t>);
+   // set the halo edges replicated from their owners and own edges replicated by neighbours
+   void setHaloEdges(const std::vector<border_edge_t>&, const std::vector<border_edge_t>&);
    /* Starts this partition in a thread. Returns true if the thread was
       successfully started, false if there was an error starting the thread */
    bool startPartition();
    // Will not return until the internal thread has exited
    void waitForPartition();
+   // launch this partition's sumo server process
+   void startServer();
    // connect to TraCI object
    void connect();
+   // read simulation parameters after connecting
+   void prepareSim();
+   // send the next step together with the border edge queries
+   void beginStep();
+   /* Reads the response to beginStep(). Returns false if wait is false and
+      the response has not fully arrived yet */
+   bool finishStep(bool);
+   // synchronize border edges with neighbouring partitions after a step
+   void synchronizeBorders();
+   // return true if the simulation has reached its end time
+   bool isFinished();
+   // descriptor of the TraCI connection for polling
+   int getSocket();
+   // timing and transfer counts of this partition
+   PartitionStats& getStats();
+   // record time spent waiting at the step barrier
+   // params: start, end (ns)
+   void recordBarrier(uint64_t, uint64_t);
+   // also query the vehicle count every step for live metrics
+   void setLiveMetrics(bool);
+   // live progress, safe to read from other threads
+   const partition_metrics_t& getMetrics();
    // get vehicles on edge
    std::vector<std::string> getEdgeVehicles(const std::string&);
    // get edges of route
    std::vector<std::string> getRouteEdges(const std::string&);
-   // add vehicle into simulation
-   void add(const std::string&, const std::string&, const std::string&,
-     const std::string&, const std::string&, const std::string&);
-   // move vehicle to specified position on lane
-   void moveTo(const std::string&, const std::string&, double);
-   // set vehicle speed to propagate traffic conditions in next partition
-   void slowDown(const std::string&, double);
+   // add vehicles arriving on border edge into simulation with their state, in one round trip
+   void addVehicles(const std::string&, std::vector<vehicle_state_t>&);
+   // set speeds of vehicles still on border edges to propagate traffic conditions
+   // in next partition, in two round trips for all given edges
+   void slowDown(const std::vector<speed_sync_t>&);
+   // stop synchronizing the speeds of given vehicles, their previous partition removed its copy
+   void releaseVehicles(const std::vector<std::string>&);
+   // replace the given owner's vehicles in this partition's halo with the streamed
+   // states (route holds "halo_<edge>"), in one round trip
+   void updateHalo(PartitionManager*, const std::vector<vehicle_state_t>&);
    // set synching boolean
    void setSynching(bool);
+   // set waiting boolean
+   void setWaiting(bool);
    // return true if partition is synching, false if not
    bool isSynching();
    // return true if partition is waiting, false if not
    bool isWaiting();
    // wait for synch to resume simulation
    void waitForSynch();
+   // count and time TraCI commands by phase, written to traci_profile_part<id>.csv on close
+   void setProfiling(bool);
+   // write tripinfos of this partition's sumo to given file and count teleports
+   void setTripinfoOutput(const std::string&);
+   // save a checkpoint to given directory every given simulation seconds
+   void setCheckpointing(const std::string&, double);
+   // also save a checkpoint when the partition reaches its end time
+   void setCheckpointAtEnd(bool);
+   // get incoming border speeds from context subscriptions on the border junctions
+   void setContextSync(bool);
+   // remove the copy of a handed off vehicle once it drove given distance further, negative to keep it
+   void setRemovalDistance(double);
+   // synchronize borders only at the sync points of given scheduler (threaded engine)
+   void setSyncScheduler(SyncScheduler*);
+   // return true if the next step ends at a sync point
+   bool syncDue();
+   // synchronize steps with given barrier instead of the pthread barrier (threaded engine)
+   void setStepBarrier(StepBarrier*);
+   /* synchronize only with given neighbours of the partition graph through the step barrier,
+      after stepping and after synchronizing. With adaptive set each link doubles its interval
+      while idle, up to the time a vehicle needs to cross its shortest border edge */
+   void setNeighbourSync(const std::vector<PartitionManager*>&, bool);
+   // index of this partition
+   int getId();
+   // partitions sharing border or halo edges with this one
+   std::vector<PartitionManager*> getNeighbours();
+   // pass extra options to this partition's sumo (e.g. --seed, --scale)
+   void setSumoOptions(const std::vector<std::string>&);
+   // resume from the checkpoint at given time in given directory
+   void setRestart(const std::string&, const std::string&);
+   // return true if a checkpoint is to be saved at the current time
+   bool checkpointDue();
+   // save sumo state and border bookkeeping, all partitions must save at the same barrier
+   void saveCheckpoint();
+   // mark the checkpoint complete once all partitions have saved it (done by partition 0)
+   void commitCheckpoint();
+   // time of the latest complete checkpoint in given directory, empty if there is none
+   static std::string latestCheckpoint(const std::string&);
+   // close TraCI connection and wait for the sumo server to exit
+   void closeConnection();
    // close TraCI connection, exit from thread
    void closePartition();
 
@@ -89,6 +303,41 @@ struct border_edge_t {
     std::vector<std::string> lanes;
     PartitionManager* from;
     PartitionManager* to;
+    // junction the edge leads to, length of its longest lane and its highest speed limit
+    std::string toJunction;
+    double length;
+    double speed;
+};
+
+// a handed off vehicle whose copy is still in this partition
+struct handoff_t {
+    PartitionManager* owner;
+    // index of the outgoing border edge and lane position to remove the copy at
+    int edge;
+    double removeAt;
+};
+
+// speeds of vehicles on a border edge for the previous partition
+struct speed_sync_t {
+    std::string edge;
+    std::vector<std::string> vehIDs;
+    std::vector<double> speeds;
+};
+
+// state of a vehicle handed to the next partition, kept in the types sumo reports
+// so it is copied from the step response without conversion
+struct vehicle_state_t {
+    std::string id;
+    std::string route;
+    std::string type;
+    std::string laneID;
+    int laneIndex;
+    double lanePos;
+    double speed;
+    // individual driving state, defaults are not applied again
+    double speedFactor;
+    int speedMode;
+    int laneChangeMode;
 };
 
 #endif
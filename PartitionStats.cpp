@@ -0,0 +1,177 @@
+/**
+PartitionStats.cpp
+
+Per-partition timing of the step loop phases. Durations go into log
+bucketed histograms (within 1/8 of the value), so recording costs one clock
+read and an increment and percentiles can be reported at the end of the run.
+
+Author: Phillip Taylor
+*/
+
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+#include "PartitionStats.h"
+
+PartitionStats::PartitionStats() :
+  handoffs(0),
+  speedSyncs(0),
+  failedAdds(0),
+  teleports(0),
+  runStart(0),
+  runEnd(0) {
+  for(int i=0; i<NUM_PHASES; i++) {
+    phases[i].buckets.assign(NUM_BUCKETS, 0);
+    phases[i].count = 0;
+    phases[i].total = 0;
+    phases[i].max = 0;
+  }
+}
+
+const char* PartitionStats::phaseName(int phase) {
+  static const char* names[NUM_PHASES] = {"step", "to_edges", "from_edges", "spin_wait", "barrier"};
+  return names[phase];
+}
+
+int PartitionStats::bucketIndex(uint64_t v) {
+  if(v < (1 << SUB_BITS))
+    return v;
+  int msb = 63 - __builtin_clzll(v);
+  int shift = msb - SUB_BITS;
+  return ((shift + 1) << SUB_BITS) + ((v >> shift) & ((1 << SUB_BITS) - 1));
+}
+
+uint64_t PartitionStats::bucketUpperBound(int i) {
+  if(i < (1 << SUB_BITS))
+    return i;
+  int shift = (i >> SUB_BITS) - 1;
+  uint64_t sub = i & ((1 << SUB_BITS) - 1);
+  return (((1 << SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+void PartitionStats::record(int phase, uint64_t ns) {
+  histogram_t& h = phases[phase];
+  h.buckets[bucketIndex(ns)]++;
+  h.count++;
+  h.total += ns;
+  if(ns > h.max)
+    h.max = ns;
+}
+
+void PartitionStats::startRun() {
+  runStart = now();
+}
+
+void PartitionStats::endRun() {
+  runEnd = now();
+}
+
+uint64_t PartitionStats::getElapsed() const {
+  return runEnd - runStart;
+}
+
+void PartitionStats::countHandoffs(int n) {
+  handoffs += n;
+}
+
+void PartitionStats::countSpeedSyncs(int n) {
+  speedSyncs += n;
+}
+
+void PartitionStats::countFailedAdds(int n) {
+  failedAdds += n;
+}
+
+void PartitionStats::countTeleports(int n) {
+  teleports += n;
+}
+
+uint64_t PartitionStats::getCount(int phase) const {
+  return phases[phase].count;
+}
+
+uint64_t PartitionStats::getTotal(int phase) const {
+  return phases[phase].total;
+}
+
+uint64_t PartitionStats::getPercentile(int phase, double q) const {
+  const histogram_t& h = phases[phase];
+  if(h.count == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(q*h.count);
+  if(rank >= h.count)
+    rank = h.count - 1;
+  uint64_t seen = 0;
+  for(int i=0; i<NUM_BUCKETS; i++) {
+    seen += h.buckets[i];
+    if(seen > rank)
+      return std::min(bucketUpperBound(i), h.max);
+  }
+  return h.max;
+}
+
+uint64_t PartitionStats::getMax(int phase) const {
+  return phases[phase].max;
+}
+
+uint64_t PartitionStats::getHandoffs() const {
+  return handoffs;
+}
+
+uint64_t PartitionStats::getSpeedSyncs() const {
+  return speedSyncs;
+}
+
+uint64_t PartitionStats::getFailedAdds() const {
+  return failedAdds;
+}
+
+uint64_t PartitionStats::getTeleports() const {
+  return teleports;
+}
+
+void PartitionStats::writeCSV(const std::string& file, const std::vector<const PartitionStats*>& stats) {
+  std::ofstream out(file);
+  if(!out) {
+    std::cout << "unable to write " << file << std::endl;
+    return;
+  }
+  out << "partition,elapsed_ms,handoffs,speed_syncs,failed_adds,teleports";
+  for(int p=0; p<NUM_PHASES; p++) {
+    std::string name = phaseName(p);
+    out << "," << name << "_count," << name << "_total_ms," << name << "_p50_us,"
+      << name << "_p99_us," << name << "_max_us";
+  }
+  out << "\n";
+  for(int i=0; i<stats.size(); i++) {
+    const PartitionStats& s = *stats[i];
+    out << i << "," << s.getElapsed()/1e6 << "," << s.handoffs << "," << s.speedSyncs << "," << s.failedAdds << "," << s.teleports;
+    for(int p=0; p<NUM_PHASES; p++) {
+      out << "," << s.getCount(p) << "," << s.getTotal(p)/1e6 << "," << s.getPercentile(p, 0.5)/1e3
+        << "," << s.getPercentile(p, 0.99)/1e3 << "," << s.getMax(p)/1e3;
+    }
+    out << "\n";
+  }
+}
+
+void PartitionStats::writeJSON(const std::string& file, const std::vector<const PartitionStats*>& stats) {
+  std::ofstream out(file);
+  if(!out) {
+    std::cout << "unable to write " << file << std::endl;
+    return;
+  }
+  out << "[\n";
+  for(int i=0; i<stats.size(); i++) {
+    const PartitionStats& s = *stats[i];
+    out << "  {\"partition\": " << i << ", \"elapsed_ms\": " << s.getElapsed()/1e6 << ", \"handoffs\": " << s.handoffs
+      << ", \"speed_syncs\": " << s.speedSyncs << ", \"failed_adds\": " << s.failedAdds
+      << ", \"teleports\": " << s.teleports << ", \"phases\": {";
+    for(int p=0; p<NUM_PHASES; p++) {
+      out << (p ? ", " : "") << "\"" << phaseName(p) << "\": {\"count\": " << s.getCount(p)
+        << ", \"total_ms\": " << s.getTotal(p)/1e6 << ", \"p50_us\": " << s.getPercentile(p, 0.5)/1e3
+        << ", \"p99_us\": " << s.getPercentile(p, 0.99)/1e3 << ", \"max_us\": " << s.getMax(p)/1e3 << "}";
+    }
+    out << "}}" << (i+1 < stats.size() ? "," : "") << "\n";
+  }
+  out << "]\n";
+}
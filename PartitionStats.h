@@ -0,0 +1,92 @@
+/**
+PartitionStats.h
+
+Class definition for PartitionStats.
+
+Author: Phillip Taylor
+*/
+
+#ifndef PARTITIONSTATS_INCLUDED
+#define PARTITIONSTATS_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <time.h>
+
+// phases of a partition's step loop
+enum partition_phase_t {
+  PHASE_STEP,
+  PHASE_TO_EDGES,
+  PHASE_FROM_EDGES,
+  PHASE_SPIN_WAIT,
+  PHASE_BARRIER,
+  NUM_PHASES
+};
+
+class PartitionStats {
+  private:
+    // log2 buckets, each split into 2^SUB_BITS linear sub buckets
+    static const int SUB_BITS = 3;
+    static const int NUM_BUCKETS = 64 << SUB_BITS;
+    struct histogram_t {
+      std::vector<uint64_t> buckets;
+      uint64_t count;
+      uint64_t total;
+      uint64_t max;
+    };
+    histogram_t phases[NUM_PHASES];
+    uint64_t handoffs;
+    uint64_t speedSyncs;
+    uint64_t failedAdds;
+    uint64_t teleports;
+    uint64_t runStart;
+    uint64_t runEnd;
+    static int bucketIndex(uint64_t);
+    static uint64_t bucketUpperBound(int);
+
+  public:
+    PartitionStats();
+    // monotonic clock in nanoseconds
+    static uint64_t now() {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+    }
+    // name of phase used in output
+    static const char* phaseName(int);
+    // add duration in nanoseconds to phase histogram
+    void record(int, uint64_t);
+    // mark start and end of the step loop
+    void startRun();
+    void endRun();
+    // wall time of the step loop in nanoseconds
+    uint64_t getElapsed() const;
+    // count vehicles handed to the next partition
+    void countHandoffs(int);
+    // count vehicle speeds synchronized into the previous partition
+    void countSpeedSyncs(int);
+    // count vehicles that could not be added to this partition
+    void countFailedAdds(int);
+    // count vehicles teleported in this partition
+    void countTeleports(int);
+    // number of samples in phase
+    uint64_t getCount(int) const;
+    // total time in phase in nanoseconds
+    uint64_t getTotal(int) const;
+    // upper bound of the given quantile (0-1) of phase durations in nanoseconds
+    uint64_t getPercentile(int, double) const;
+    // longest phase duration in nanoseconds
+    uint64_t getMax(int) const;
+    uint64_t getHandoffs() const;
+    uint64_t getSpeedSyncs() const;
+    uint64_t getFailedAdds() const;
+    uint64_t getTeleports() const;
+    // write one row per partition
+    static void writeCSV(const std::string&, const std::vector<const PartitionStats*>&);
+    // write an array with one object per partition
+    static void writeJSON(const std::string&, const std::vector<const PartitionStats*>&);
+
+};
+
+#endif
@@ -1,3 +1,5 @@
+#ifdef __APPLE__
+
 #include <errno.h>
 #include <pthread.h>
 #include "Pthread_barrier.h"
@@ -20,6 +22,7 @@ int pthread_barrier_init(pthread_barrier_t *barrier, const pthread_barrierattr_t
     }
     barrier->tripCount = count;
     barrier->count = 0;
+    barrier->cycle = 0;
 
     return 0;
 }
@@ -38,14 +41,20 @@ int pthread_barrier_wait(pthread_barrier_t *barrier)
     if(barrier->count >= barrier->tripCount)
     {
         barrier->count = 0;
+        barrier->cycle++;
         pthread_cond_broadcast(&barrier->cond);
         pthread_mutex_unlock(&barrier->mutex);
         return 1;
     }
     else
     {
-        pthread_cond_wait(&barrier->cond, &(barrier->mutex));
+        // condition variables may wake spuriously, only a new cycle releases the waiters
+        int cycle = barrier->cycle;
+        while(cycle == barrier->cycle)
+            pthread_cond_wait(&barrier->cond, &(barrier->mutex));
         pthread_mutex_unlock(&barrier->mutex);
         return 0;
     }
 }
+
+#endif // __APPLE__
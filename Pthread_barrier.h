@@ -10,6 +10,7 @@ typedef struct
     pthread_cond_t cond;
     int count;
     int tripCount;
+    int cycle;
 } pthread_barrier_t;
 
 
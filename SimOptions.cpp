@@ -0,0 +1,205 @@
+/**
+SimOptions.cpp
+
+Command line and config file options shared by the programs driving a
+ParallelSim. Options can be given as flags or in a config file of
+"<option> <value>" lines (option names without the leading dashes, '#' starts
+a comment); flags override the config file.
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include "SimOptions.h"
+
+static const char* OPTIONS =
+  "  --config <file>               read options from file, flags override it\n"
+  "  --cfg <sumo cfg>              sumo config to run (assets/simpleNet.sumocfg)\n"
+  "  --host <host>                 host of the partition servers (localhost)\n"
+  "  --port <port>                 first partition port, partition i uses port+i (1337)\n"
+  "  --threads <n>                 number of partitions (4)\n"
+  "  --gui                         run partitions in sumo-gui\n"
+  "  --partition <metis|grid|none> partition the network first, none reuses earlier partitions (none)\n"
+  "  --routes-only                 only re-cut routes for the existing partition nets\n"
+  "  --work-dir <dir>              directory of the partition files (cwd)\n"
+  "  --event-workers <k>           drive partitions from k event driven workers\n"
+  "  --work-stealing               event workers take any ready partition instead of a fixed share\n"
+  "  --stats <prefix>              phase timing output prefix, 'none' to disable (partition_stats)\n"
+  "  --traci-profile               profile TraCI commands of each partition\n"
+  "  --metrics <[host:]port>       serve prometheus metrics, host 'unix:<path>' for a unix socket\n"
+  "  --trace <file>                write a chrome trace of partition events\n"
+  "  --tripinfo <prefix>           write tripinfos of each partition\n"
+  "  --checkpoint-dir <dir>        directory for checkpoints\n"
+  "  --checkpoint-interval <s>     save a checkpoint every s simulation seconds\n"
+  "  --restart <dir>               resume from the latest checkpoint in dir\n"
+  "  --warm-up <s>                 run until s and save a checkpoint to --checkpoint-dir\n"
+  "  --sumo-option <option>        pass an option to every partition's sumo (repeatable)\n"
+  "  --border-sync <edges|context> query border vehicle speeds per vehicle or from junction subscriptions (edges)\n"
+  "  --halo <n>                    replicate n edges beyond each partition border from their owner (0)\n"
+  "  --remove-after <m>            remove a handed off vehicle's old copy m metres after the handoff (keep)\n"
+  "  --adaptive-sync               synchronize borders less often while they carry no vehicles\n"
+  "  --barrier <pthread|dissemination|neighbour> step barrier of the partition threads (pthread)\n";
+
+// flags that take no value on the command line
+static const std::set<std::string> switches = {"gui", "traci-profile", "routes-only", "adaptive-sync", "work-stealing"};
+static const std::set<std::string> known = {"config", "cfg", "host", "port", "threads", "gui", "partition",
+  "routes-only", "work-dir", "event-workers", "stats", "traci-profile", "metrics", "trace",
+  "tripinfo", "checkpoint-dir", "checkpoint-interval", "restart", "warm-up", "sumo-option", "border-sync", "halo", "remove-after", "adaptive-sync", "barrier", "work-stealing"};
+
+SimOptions::SimOptions(const std::string& usage) : usage(usage) {}
+
+void SimOptions::printUsage() {
+  std::cout << usage << "\n" << OPTIONS;
+}
+
+void SimOptions::setOption(const std::string& name, const std::string& value) {
+  if(known.find(name) == known.end()) {
+    std::cout << "unknown option '" << name << "'\n";
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+  if(name == "sumo-option")
+    sumoOptions.push_back(value);
+  else
+    values[name] = value;
+}
+
+void SimOptions::readConfig(const std::string& file) {
+  std::ifstream in(file);
+  if(!in) {
+    std::cout << "unable to read config file " << file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::string line;
+  while(getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    std::string name, value;
+    if(!(words >> name))
+      continue;
+    getline(words >> std::ws, value);
+    if(value.empty() && switches.find(name) != switches.end())
+      value = "true";
+    setOption(name, value);
+  }
+}
+
+void SimOptions::parse(int argc, char* argv[], int first) {
+  // the config file is read first so flags can override it
+  for(int i=first; i+1<argc; i++) {
+    if(strcmp(argv[i], "--config") == 0)
+      readConfig(argv[i+1]);
+  }
+  for(int i=first; i<argc; i++) {
+    std::string arg = argv[i];
+    if(arg == "-h" || arg == "--help") {
+      printUsage();
+      exit(EXIT_SUCCESS);
+    }
+    if(arg.compare(0, 2, "--") != 0) {
+      std::cout << "unexpected argument '" << arg << "'\n";
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+    std::string name = arg.substr(2);
+    if(switches.find(name) != switches.end()) {
+      setOption(name, "true");
+      continue;
+    }
+    if(i+1 >= argc) {
+      std::cout << "option --" << name << " needs a value" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    setOption(name, argv[++i]);
+  }
+}
+
+std::string SimOptions::get(const std::string& name, const std::string& def) {
+  auto it = values.find(name);
+  return it == values.end() ? def : it->second;
+}
+
+bool SimOptions::isSet(const std::string& name) {
+  std::string value = get(name, "false");
+  return value == "true" || value == "1" || value == "yes";
+}
+
+void SimOptions::apply(ParallelSim& sim) {
+  std::string workDir = get("work-dir", "");
+  if(!workDir.empty())
+    sim.setWorkDir(workDir);
+  sim.setEventWorkers(atoi(get("event-workers", "0").c_str()));
+  sim.setWorkStealing(isSet("work-stealing"));
+  std::string stats = get("stats", "partition_stats");
+  sim.setStatsOutput(stats == "none" ? "" : stats);
+  sim.setTraCIProfiling(isSet("traci-profile"));
+  std::string metrics = get("metrics", "");
+  if(!metrics.empty()) {
+    // "unix:<path>", "<host>:<port>" or "<port>"
+    std::size_t colon = metrics.rfind(':');
+    if(metrics.compare(0, 5, "unix:") == 0)
+      sim.setMetricsEndpoint(metrics, 0);
+    else if(colon != std::string::npos)
+      sim.setMetricsEndpoint(metrics.substr(0, colon), atoi(metrics.substr(colon+1).c_str()));
+    else
+      sim.setMetricsEndpoint("", atoi(metrics.c_str()));
+  }
+  std::string trace = get("trace", "");
+  if(!trace.empty())
+    sim.setTraceOutput(trace);
+  std::string tripinfo = get("tripinfo", "");
+  if(!tripinfo.empty())
+    sim.setTripinfoOutput(tripinfo);
+  std::string checkpointDir = get("checkpoint-dir", "checkpoints");
+  double interval = atof(get("checkpoint-interval", "0").c_str());
+  if(interval > 0)
+    sim.setCheckpointing(checkpointDir, interval);
+  int warmUp = atoi(get("warm-up", "0").c_str());
+  if(warmUp > 0)
+    sim.warmUp(checkpointDir, warmUp);
+  std::string restart = get("restart", "");
+  if(!restart.empty())
+    sim.restartFrom(restart);
+  sim.setSumoOptions(sumoOptions);
+  std::string borderSync = get("border-sync", "edges");
+  if(borderSync != "edges" && borderSync != "context") {
+    std::cout << "--border-sync must be edges or context" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  sim.setContextSync(borderSync == "context");
+  sim.setHaloDepth(atoi(get("halo", "0").c_str()));
+  sim.setRemovalDistance(atof(get("remove-after", "-1").c_str()));
+  sim.setAdaptiveSync(isSet("adaptive-sync"));
+  std::string barrier = get("barrier", "pthread");
+  if(barrier != "pthread" && barrier != "dissemination" && barrier != "neighbour") {
+    std::cout << "--barrier must be pthread, dissemination or neighbour" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  sim.setBarrier(barrier);
+}
+
+std::string SimOptions::getMode() {
+  std::string mode = get("border-sync", "edges");
+  int halo = atoi(get("halo", "0").c_str());
+  if(halo > 0)
+    mode += "+halo"+std::to_string(halo);
+  std::string removal = get("remove-after", "-1");
+  if(atof(removal.c_str()) >= 0)
+    mode += "+remove"+removal;
+  if(isSet("adaptive-sync"))
+    mode += "+adaptive";
+  int workers = atoi(get("event-workers", "0").c_str());
+  // the barrier only applies to partition threads
+  if(workers > 0)
+    mode += "+events"+std::to_string(workers);
+  else
+    mode += "+"+get("barrier", "pthread");
+  if(workers > 0 && isSet("work-stealing"))
+    mode += "+stealing";
+  return mode;
+}
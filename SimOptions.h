@@ -0,0 +1,43 @@
+/**
+SimOptions.h
+
+Class definition for SimOptions.
+
+Author: Phillip Taylor
+*/
+
+#ifndef SIMOPTIONS_INCLUDED
+#define SIMOPTIONS_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ParallelSim.h"
+
+class SimOptions {
+  private:
+    // first usage line of the program
+    std::string usage;
+    std::map<std::string, std::string> values;
+    std::vector<std::string> sumoOptions;
+    void printUsage();
+    // exit on unknown options
+    void setOption(const std::string&, const std::string&);
+    void readConfig(const std::string&);
+
+  public:
+    // param: first usage line of the program, the shared options are listed below it
+    SimOptions(const std::string&);
+    // read the --config file, then the flags from given index on, which override it
+    void parse(int, char* [], int);
+    // params: option name, default value
+    std::string get(const std::string&, const std::string&);
+    bool isSet(const std::string&);
+    // apply the run options to sim, everything but the constructor and partitioning options
+    void apply(ParallelSim&);
+    // short name of the chosen sync engine, e.g. context+halo2+adaptive+neighbour
+    std::string getMode();
+
+};
+
+#endif
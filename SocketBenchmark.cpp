@@ -0,0 +1,105 @@
+/**
+SocketBenchmark.cpp
+
+Measures per-call round trip latency of TraCI sized messages over tcp
+and unix domain socket connections. A server thread echoes every framed
+message back, the client times each sendExact/receiveExact pair.
+
+usage: socketbench [calls] [payload bytes]
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "socket.h"
+
+struct echo_args_t {
+  tcpip::Socket* server;
+  int calls;
+};
+
+static void* echoServer(void* arg) {
+  echo_args_t* args = (echo_args_t*) arg;
+  tcpip::Socket* client = args->server->accept(true);
+  tcpip::Storage msg;
+  for(int i=0; i<args->calls; i++) {
+    client->receiveExact(msg);
+    client->sendExact(msg);
+  }
+  delete client;
+  return NULL;
+}
+
+static double nowMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+// run calls round trips against an echo server on the given endpoint
+static void runBenchmark(const std::string& label, const std::string& host, int port, int calls, int payload) {
+  tcpip::Socket server(host, port);
+  echo_args_t args = {&server, calls};
+  pthread_t serverThread;
+  if(pthread_create(&serverThread, NULL, echoServer, &args) != 0) {
+    std::cout << "unable to start echo server" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  tcpip::Socket client(host, port);
+  // server needs to be listening before the client connects
+  for(int tries=0; ; tries++) {
+    try {
+      client.connect();
+      break;
+    }
+    catch(tcpip::SocketException&) {
+      client.close();
+      if(tries == 100)
+        throw;
+      usleep(10000);
+    }
+  }
+
+  tcpip::Storage request;
+  for(int i=0; i<payload; i++)
+    request.writeUnsignedByte(i%256);
+  tcpip::Storage response;
+  std::vector<double> samples;
+  samples.reserve(calls);
+  for(int i=0; i<calls; i++) {
+    double start = nowMicros();
+    client.sendExact(request);
+    client.receiveExact(response);
+    samples.push_back(nowMicros()-start);
+  }
+  pthread_join(serverThread, NULL);
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for(double s : samples)
+    sum += s;
+  printf("%-6s calls: %d  mean: %.2fus  p50: %.2fus  p99: %.2fus  max: %.2fus\n", label.c_str(), calls,
+    sum/calls, samples[calls/2], samples[(calls*99)/100], samples.back());
+}
+
+int main(int argc, char* argv[]) {
+  int calls = argc > 1 ? atoi(argv[1]) : 100000;
+  int payload = argc > 2 ? atoi(argv[2]) : 32;
+  if(calls <= 0 || payload <= 0) {
+    std::cout << "usage: socketbench [calls] [payload bytes]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::string unixPath = "socketbench"+std::to_string(getpid())+".sock";
+
+  runBenchmark("tcp", "localhost", tcpip::Socket::getFreeSocketPort(), calls, payload);
+  runBenchmark("unix", tcpip::Socket::unixPrefix+unixPath, 0, calls, payload);
+}
@@ -0,0 +1,394 @@
+/**
+StealingExecutor.cpp
+
+Drives more partitions than worker threads without stepping them in
+lockstep. A partition's next task is queued as soon as its dependencies are
+met: it may be synchronized once it and all its neighbours have finished
+the step, and step on once its neighbours have synchronized it. Workers run
+the newest partition from their own queue and steal the oldest from others
+when it is empty, so light partitions are packed onto few workers while a
+heavy one keeps a worker to itself. Step responses are collected from a
+shared epoll set (blocking in the task where epoll is unavailable). Idle
+workers sleep until a response arrives or a wakeup token is posted for
+queued work, taking one token each.
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+#include "TraCIAPI.h"
+#include "PartitionManager.h"
+#include "StealingExecutor.h"
+
+StealingExecutor::StealingExecutor(std::vector<PartitionManager*>& parts, int workers) :
+  parts(parts),
+  count(parts.size()),
+  numWorkers(workers),
+  done(0),
+  idle(0),
+  saved(0),
+  commits(0),
+  pollFd(-1) {
+  if(numWorkers > count)
+    numWorkers = count;
+  if(numWorkers < 1)
+    numWorkers = 1;
+  nodes = new node_t[count];
+  for(int i=0; i<count; i++) {
+    nodes[i].part = parts[i];
+    for(PartitionManager* neighbour : parts[i]->getNeighbours())
+      nodes[i].neighbours.push_back(neighbour->getId());
+    nodes[i].phase = NEXT_STEP;
+    nodes[i].stepped = 0;
+    nodes[i].synced = 0;
+    nodes[i].claimed = false;
+    nodes[i].saves = 0;
+    nodes[i].idleSince = 0;
+  }
+}
+
+StealingExecutor::~StealingExecutor() {
+  delete[] nodes;
+}
+
+void StealingExecutor::run() {
+  for(PartitionManager* part : parts)
+    part->startServer();
+  // wait for servers to startup (1 second)
+  usleep(1000000);
+  for(PartitionManager* part : parts) {
+    part->connect();
+    part->prepareSim();
+    // neighbours may update a partition whenever it is not running a task
+    part->setWaiting(true);
+  }
+
+#ifdef __linux__
+  // a counter of wakeup tokens, readable while any is left and read one at a time
+  wakeFds[0] = wakeFds[1] = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK);
+  if(wakeFds[0] < 0) {
+    perror("eventfd");
+    exit(EXIT_FAILURE);
+  }
+  pollFd = epoll_create1(0);
+  if(pollFd < 0) {
+    perror("epoll_create1");
+    exit(EXIT_FAILURE);
+  }
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.u32 = count;
+  if(epoll_ctl(pollFd, EPOLL_CTL_ADD, wakeFds[0], &ev) < 0) {
+    perror("epoll_ctl");
+    exit(EXIT_FAILURE);
+  }
+  // sockets are armed for one response at a time
+  for(int i=0; i<count; i++) {
+    ev.events = EPOLLONESHOT;
+    ev.data.u32 = i;
+    if(epoll_ctl(pollFd, EPOLL_CTL_ADD, parts[i]->getSocket(), &ev) < 0) {
+      perror("epoll_ctl");
+      exit(EXIT_FAILURE);
+    }
+  }
+#else
+  // one byte per wakeup token
+  if(pipe(wakeFds) < 0) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+  fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+#endif
+
+  workers.resize(numWorkers);
+  for(int i=0; i<numWorkers; i++)
+    pthread_mutex_init(&workers[i].lock, NULL);
+  // every partition can take its first step, dealt out round robin
+  for(int i=0; i<count; i++) {
+    nodes[i].idleSince = PartitionStats::now();
+    tryEnqueue(i%numWorkers, i);
+  }
+  for(PartitionManager* part : parts)
+    part->getStats().startRun();
+  for(int i=0; i<numWorkers; i++) {
+    workers[i].executor = this;
+    workers[i].id = i;
+    if(pthread_create(&workers[i].thread, NULL, workerFunc, &workers[i]) != 0) {
+      printf("Error creating worker %d", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+  for(int i=0; i<numWorkers; i++)
+    pthread_join(workers[i].thread, NULL);
+  for(PartitionManager* part : parts)
+    part->getStats().endRun();
+
+  for(int i=0; i<numWorkers; i++)
+    pthread_mutex_destroy(&workers[i].lock);
+#ifdef __linux__
+  close(pollFd);
+  close(wakeFds[0]);
+#else
+  close(wakeFds[0]);
+  close(wakeFds[1]);
+#endif
+  for(PartitionManager* part : parts)
+    part->closeConnection();
+}
+
+bool StealingExecutor::pop(int w, int& p) {
+  worker_t& worker = workers[w];
+  pthread_mutex_lock(&worker.lock);
+  bool found = !worker.tasks.empty();
+  if(found) {
+    p = worker.tasks.back();
+    worker.tasks.pop_back();
+  }
+  pthread_mutex_unlock(&worker.lock);
+  return found;
+}
+
+bool StealingExecutor::steal(int w, int& p) {
+  for(int i=1; i<numWorkers; i++) {
+    worker_t& victim = workers[(w+i)%numWorkers];
+    pthread_mutex_lock(&victim.lock);
+    bool found = !victim.tasks.empty();
+    if(found) {
+      p = victim.tasks.front();
+      victim.tasks.pop_front();
+    }
+    pthread_mutex_unlock(&victim.lock);
+    if(found)
+      return true;
+  }
+  return false;
+}
+
+void StealingExecutor::push(int w, int p) {
+  worker_t& worker = workers[w];
+  pthread_mutex_lock(&worker.lock);
+  worker.tasks.push_back(p);
+  pthread_mutex_unlock(&worker.lock);
+  // idle workers are counted before they look at the queues, so none sleeps past this task
+  if(idle > 0)
+    wake(1);
+}
+
+void StealingExecutor::wake(int n) {
+#ifdef __linux__
+  uint64_t tokens = n;
+  if(write(wakeFds[1], &tokens, sizeof(tokens)) < 0)
+    perror("write");
+#else
+  for(int i=0; i<n; i++) {
+    if(write(wakeFds[1], "x", 1) < 0 && errno != EAGAIN)
+      perror("write");
+  }
+#endif
+}
+
+void StealingExecutor::takeToken() {
+  // another woken worker may have taken the last token, it then runs the queued work
+#ifdef __linux__
+  uint64_t token;
+  if(read(wakeFds[0], &token, sizeof(token)) < 0 && errno != EAGAIN)
+    perror("read");
+#else
+  char token;
+  if(read(wakeFds[0], &token, 1) < 0 && errno != EAGAIN)
+    perror("read");
+#endif
+}
+
+bool StealingExecutor::ready(int p) {
+  node_t& node = nodes[p];
+  switch(node.phase) {
+    case NEXT_STEP:
+      // neighbours are done updating this partition for the step
+      for(int q : node.neighbours) {
+        if(nodes[q].synced < node.synced)
+          return false;
+      }
+      return true;
+    case SYNC:
+      // neighbours have stepped before their borders are touched
+      for(int q : node.neighbours) {
+        if(nodes[q].stepped < node.stepped)
+          return false;
+      }
+      return true;
+    case SAVED:
+      return commits >= node.saves;
+    default:
+      return false;
+  }
+}
+
+void StealingExecutor::tryEnqueue(int w, int p) {
+  std::atomic<bool>& claimed = nodes[p].claimed;
+  while(ready(p)) {
+    bool expected = false;
+    if(!claimed.compare_exchange_strong(expected, true))
+      return;
+    // the phase may have moved on between the check and the claim
+    if(ready(p)) {
+      push(w, p);
+      return;
+    }
+    // a dependency completed while the claim was held failed to queue the partition
+    claimed = false;
+  }
+}
+
+void StealingExecutor::complete(int w, int p) {
+  node_t& node = nodes[p];
+  node.idleSince = PartitionStats::now();
+  node.claimed = false;
+  tryEnqueue(w, p);
+  for(int q : node.neighbours)
+    tryEnqueue(w, q);
+}
+
+void StealingExecutor::runTask(int w, int p) {
+  node_t& node = nodes[p];
+  PartitionManager* part = node.part;
+  // time a partition waits for its dependencies or a worker
+  part->recordBarrier(node.idleSince, PartitionStats::now());
+  switch(node.phase) {
+    case NEXT_STEP:
+      if(part->checkpointDue()) {
+        part->saveCheckpoint();
+        node.saves++;
+        node.phase = SAVED;
+        // neighbours may only be changed again once every partition has saved
+        if(++saved == count) {
+          saved = 0;
+          parts[0]->commitCheckpoint();
+          commits++;
+          for(int i=0; i<count; i++)
+            tryEnqueue(w, i);
+        }
+        complete(w, p);
+        return;
+      }
+      step(w, p);
+      return;
+    case SAVED:
+      step(w, p);
+      return;
+    case SYNC:
+      part->setWaiting(false);
+      part->synchronizeBorders();
+      // waitForSynch clears the flag, neighbours may still need to update this partition
+      part->setWaiting(true);
+      node.synced++;
+      node.phase = NEXT_STEP;
+      complete(w, p);
+      return;
+  }
+}
+
+void StealingExecutor::step(int w, int p) {
+  node_t& node = nodes[p];
+  PartitionManager* part = node.part;
+  if(part->isFinished()) {
+    // the partition stays claimed, nobody runs it again
+    node.phase = DONE;
+    if(++done == count)
+      wake(numWorkers);
+    return;
+  }
+  part->setWaiting(false);
+  part->beginStep();
+  node.phase = STEPPING;
+#ifdef __linux__
+  arm(p);
+#else
+  part->finishStep(true);
+  part->setWaiting(true);
+  node.stepped++;
+  node.phase = SYNC;
+  complete(w, p);
+#endif
+}
+
+void StealingExecutor::arm(int p) {
+#ifdef __linux__
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.u32 = p;
+  // a response already received is reported right away
+  if(epoll_ctl(pollFd, EPOLL_CTL_MOD, parts[p]->getSocket(), &ev) < 0) {
+    perror("epoll_ctl");
+    exit(EXIT_FAILURE);
+  }
+#endif
+}
+
+void StealingExecutor::waitEvents(int w) {
+#ifdef __linux__
+  struct epoll_event events[64];
+  int n = epoll_wait(pollFd, events, 64, -1);
+  if(n < 0) {
+    if(errno == EINTR)
+      return;
+    perror("epoll_wait");
+    exit(EXIT_FAILURE);
+  }
+  for(int j=0; j<n; j++) {
+    int p = events[j].data.u32;
+    if(p == count) {
+      takeToken();
+      continue;
+    }
+    // one worker gets each response, so the partition is still held by its step
+    if(!parts[p]->finishStep(false)) {
+      arm(p);
+      continue;
+    }
+    parts[p]->setWaiting(true);
+    nodes[p].stepped++;
+    nodes[p].phase = SYNC;
+    complete(w, p);
+  }
+#else
+  struct pollfd fd = {wakeFds[0], POLLIN, 0};
+  if(poll(&fd, 1, -1) < 0) {
+    if(errno == EINTR)
+      return;
+    perror("poll");
+    exit(EXIT_FAILURE);
+  }
+  takeToken();
+#endif
+}
+
+void StealingExecutor::runWorker(int w) {
+  while(done < count) {
+    int p;
+    if(pop(w, p) || steal(w, p)) {
+      runTask(w, p);
+      continue;
+    }
+    idle++;
+    // look again once counted, a task queued before is not signalled
+    if(pop(w, p) || steal(w, p)) {
+      idle--;
+      runTask(w, p);
+      continue;
+    }
+    waitEvents(w);
+    idle--;
+  }
+}
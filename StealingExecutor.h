@@ -0,0 +1,106 @@
+/**
+StealingExecutor.h
+
+Class definition for StealingExecutor.
+
+Author: Phillip Taylor
+*/
+
+#ifndef STEALINGEXECUTOR_INCLUDED
+#define STEALINGEXECUTOR_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+class PartitionManager;
+
+class StealingExecutor {
+  private:
+    // next task of a partition
+    enum {
+      NEXT_STEP,
+      STEPPING,
+      SYNC,
+      SAVED,
+      DONE
+    };
+    // scheduling state of one partition
+    struct node_t {
+      PartitionManager* part;
+      // indices of the partitions sharing border or halo edges
+      std::vector<int> neighbours;
+      std::atomic<int> phase;
+      // steps received and synchronized
+      std::atomic<int64_t> stepped;
+      std::atomic<int64_t> synced;
+      // queued or running on a worker
+      std::atomic<bool> claimed;
+      // checkpoints saved, read by the worker committing the checkpoint
+      std::atomic<int> saves;
+      // time the last task ended
+      uint64_t idleSince;
+    };
+    struct worker_t {
+      StealingExecutor* executor;
+      int id;
+      pthread_t thread;
+      // ready partitions, the owner takes the newest and thieves the oldest
+      std::deque<int> tasks;
+      pthread_mutex_t lock;
+    };
+    std::vector<PartitionManager*>& parts;
+    int count;
+    int numWorkers;
+    node_t* nodes;
+    std::vector<worker_t> workers;
+    // partitions done, workers waiting for work, checkpoints saved and committed
+    std::atomic<int> done;
+    std::atomic<int> idle;
+    std::atomic<int> saved;
+    std::atomic<int> commits;
+    // step responses (epoll where available), and wakeup tokens for idle workers
+    // in an eventfd semaphore (a pipe elsewhere)
+    int pollFd;
+    int wakeFds[2];
+    // thread helper function
+    static void * workerFunc(void* w){
+      ((worker_t*)w)->executor->runWorker(((worker_t*)w)->id);
+      return NULL;
+    }
+    // take ready partitions from own queue or steal them from others until all are done
+    void runWorker(int);
+    bool pop(int, int&);
+    bool steal(int, int&);
+    void push(int, int);
+    // return true if the dependencies of the partition's next task are met
+    bool ready(int);
+    // queue the partition on given worker if its next task is ready and nobody holds it
+    void tryEnqueue(int, int);
+    // run the next task of given partition
+    void runTask(int, int);
+    // send the partition's next step, or mark it done once it reached its end time
+    void step(int, int);
+    // release the partition after a task, queueing it and its neighbours if now ready
+    void complete(int, int);
+    // wait for step responses or queued work
+    void waitEvents(int);
+    // watch the partition's socket for its step response
+    void arm(int);
+    // post given number of wakeup tokens, each wakes one idle worker
+    void wake(int);
+    // take one wakeup token if any is left
+    void takeToken();
+
+  public:
+    // params: partitions, number of worker threads
+    StealingExecutor(std::vector<PartitionManager*>&, int);
+    ~StealingExecutor();
+    // start all partitions and return when they have reached their end time
+    void run();
+
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**
+StepBarrier.cpp
+
+Barrier for the step synchronization of many partitions. wait() is a
+dissemination barrier: in round k participant i signals participant
+i+2^k and waits for the signal of i-2^k, so after ceil(log2 n) rounds
+everyone has heard from everyone, without a shared counter all threads
+contend on. waitNeighbours() only waits for the participants sharing border
+edges with the caller at a step, so partitions without a common border
+never wait for each other. Waiters spin for a while, then block on their own
+condition variable, so a release never wakes the whole pool at once.
+
+Author: Phillip Taylor
+*/
+
+#include "StepBarrier.h"
+
+StepBarrier::StepBarrier(int count, int spins) :
+  count(count),
+  rounds(0),
+  spins(spins) {
+  while((1 << rounds) < count)
+    rounds++;
+  slots = new slot_t[count];
+  for(int i=0; i<count; i++) {
+    slots[i].flags = std::vector<std::atomic<int64_t> >(rounds);
+    for(std::atomic<int64_t>& flag : slots[i].flags)
+      flag = 0;
+    slots[i].episode = 0;
+    slots[i].reached[0] = -1;
+    slots[i].reached[1] = -1;
+    slots[i].sleeping = false;
+    pthread_mutex_init(&slots[i].mutex, NULL);
+    pthread_cond_init(&slots[i].cond, NULL);
+  }
+}
+
+StepBarrier::~StepBarrier() {
+  for(int i=0; i<count; i++) {
+    pthread_cond_destroy(&slots[i].cond);
+    pthread_mutex_destroy(&slots[i].mutex);
+  }
+  delete[] slots;
+}
+
+void StepBarrier::wake(int id) {
+  slot_t& slot = slots[id];
+  // the flag was raised before, so either the waiter sees it or is seen asleep
+  if(slot.sleeping) {
+    pthread_mutex_lock(&slot.mutex);
+    pthread_cond_signal(&slot.cond);
+    pthread_mutex_unlock(&slot.mutex);
+  }
+}
+
+void StepBarrier::waitFor(int id, const std::atomic<int64_t>& flag, int64_t target) {
+  for(int i=0; i<spins; i++) {
+    if(flag >= target)
+      return;
+  }
+  slot_t& slot = slots[id];
+  pthread_mutex_lock(&slot.mutex);
+  slot.sleeping = true;
+  while(flag < target)
+    pthread_cond_wait(&slot.cond, &slot.mutex);
+  slot.sleeping = false;
+  pthread_mutex_unlock(&slot.mutex);
+}
+
+void StepBarrier::wait(int id) {
+  slot_t& slot = slots[id];
+  int64_t episode = ++slot.episode;
+  for(int k=0; k<rounds; k++) {
+    // a partner one barrier ahead may already have signalled, so flags count up
+    int partner = (id+(1 << k))%count;
+    slots[partner].flags[k]++;
+    wake(partner);
+    waitFor(id, slot.flags[k], episode);
+  }
+}
+
+void StepBarrier::waitNeighbours(int id, int phase, int64_t step, const std::vector<int>& neighbours) {
+  slots[id].reached[phase] = step;
+  for(int neighbour : neighbours)
+    wake(neighbour);
+  // the neighbours wait for this participant at the same step, so none passes it alone
+  for(int neighbour : neighbours)
+    waitFor(id, slots[neighbour].reached[phase], step);
+}
@@ -0,0 +1,54 @@
+/**
+StepBarrier.h
+
+Class definition for StepBarrier.
+
+Author: Phillip Taylor
+*/
+
+#ifndef STEPBARRIER_INCLUDED
+#define STEPBARRIER_INCLUDED
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <pthread.h>
+
+class StepBarrier {
+  private:
+    // state owned by one participant, padded to its own cache lines
+    struct slot_t {
+      // signals received in each dissemination round
+      std::vector<std::atomic<int64_t> > flags;
+      // barriers passed, and the step last reached in each neighbour phase
+      int64_t episode;
+      std::atomic<int64_t> reached[2];
+      // blocked after spinning
+      std::atomic<bool> sleeping;
+      pthread_mutex_t mutex;
+      pthread_cond_t cond;
+      char pad[64];
+    };
+    int count;
+    int rounds;
+    int spins;
+    slot_t* slots;
+    // wake the participant if it blocked
+    void wake(int);
+    // spin, then block until the participant's flag reaches the target
+    void waitFor(int, const std::atomic<int64_t>&, int64_t);
+
+  public:
+    // params: number of participants, checks before blocking
+    StepBarrier(int, int spins = 4000);
+    ~StepBarrier();
+    // dissemination barrier over all participants. param: participant
+    void wait(int);
+    /* point-to-point barrier: wait until the given neighbours have reached the given
+       step in the same phase (0 or 1). Neighbours must wait for each other at the same steps.
+       params: participant, phase, step, neighbours */
+    void waitNeighbours(int, int, int64_t, const std::vector<int>&);
+
+};
+
+#endif
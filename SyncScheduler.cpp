@@ -0,0 +1,54 @@
+/**
+SyncScheduler.cpp
+
+Decides how many steps partitions run between border synchronizations.
+Every partition reports the vehicles on its border edges at a sync point;
+after the barrier all of them read the same total, so they agree on the next
+sync point without another exchange. The interval doubles while no border
+carries vehicles and halves when they do, and never exceeds the lookahead:
+the shortest time a vehicle needs to cross a border edge, so no vehicle can
+enter and leave a border edge between two sync points.
+
+Author: Phillip Taylor
+*/
+
+#include <algorithm>
+#include "SyncScheduler.h"
+
+// highest speed factor expected of a vehicle
+static const double MAX_SPEED_FACTOR = 1.5;
+
+SyncScheduler::SyncScheduler(double lookahead) :
+  lookahead(lookahead) {
+  for(int i=0; i<3; i++)
+    activity[i] = 0;
+}
+
+int SyncScheduler::maxInterval(double deltaT) {
+  if(deltaT <= 0)
+    return 1;
+  return std::max(1, (int)(lookahead/deltaT));
+}
+
+void SyncScheduler::report(int round, int vehicles) {
+  activity[round%3] += vehicles;
+}
+
+int SyncScheduler::nextInterval(int round, int interval, double deltaT) {
+  int vehicles = activity[round%3];
+  // everyone has read the previous round before this barrier, and nobody
+  // reports the round after next before the following one
+  activity[(round+2)%3] = 0;
+  return adapt(interval, vehicles, maxInterval(deltaT));
+}
+
+int SyncScheduler::adapt(int interval, int vehicles, int longest) {
+  if(vehicles == 0)
+    return std::max(1, std::min(interval*2, longest));
+  return std::max(1, interval/2);
+}
+
+double SyncScheduler::crossingTime(double length, double speed) {
+  // vehicles may drive faster than the limit by their speed factor
+  return length/(speed*MAX_SPEED_FACTOR);
+}
@@ -0,0 +1,39 @@
+/**
+SyncScheduler.h
+
+Class definition for SyncScheduler.
+
+Author: Phillip Taylor
+*/
+
+#ifndef SYNCSCHEDULER_INCLUDED
+#define SYNCSCHEDULER_INCLUDED
+
+#include <atomic>
+
+class SyncScheduler {
+  private:
+    // longest time a vehicle can stay unseen on a border edge (s)
+    double lookahead;
+    // border vehicles reported for the last rounds, indexed by round % 3
+    std::atomic<int> activity[3];
+
+  public:
+    // param: lookahead (s)
+    SyncScheduler(double);
+    // longest interval between sync points in steps of given length
+    int maxInterval(double);
+    // add a partition's border vehicles at the sync point of given round, before the barrier
+    void report(int, int);
+    /* interval until the next sync point, the same for every partition. Called
+       after the barrier of given round with the current interval and step length */
+    int nextInterval(int, int, double);
+    // interval after one with given border vehicles: doubled while idle, halved when busy
+    // params: interval, vehicles, longest interval
+    static int adapt(int, int, int);
+    // time a vehicle needs at least to cross an edge of given length and speed limit (s)
+    static double crossingTime(double, double);
+
+};
+
+#endif
@@ -24,6 +24,8 @@
 // ===========================================================================
 #include "config.h"
 
+#include <algorithm>
+
 #include "TraCIAPI.h"
 
 
@@ -44,7 +46,8 @@ TraCIAPI::TraCIAPI()
       person(*this), poi(*this), polygon(*this), route(*this),
       simulation(*this), trafficlights(*this),
       vehicle(*this), vehicletype(*this),
-      mySocket(nullptr) {
+      mySocket(nullptr), myProfiling(false), myProfilePhase(-1),
+      myProfileCommand(-1), myProfileVariable(-1), myUseSubscriptionStore(false) {
     myDomains[libsumo::RESPONSE_SUBSCRIBE_EDGE_VARIABLE] = &edge;
     myDomains[libsumo::RESPONSE_SUBSCRIBE_GUI_VARIABLE] = &gui;
     myDomains[libsumo::RESPONSE_SUBSCRIBE_JUNCTION_VARIABLE] = &junction;
@@ -158,24 +161,35 @@ TraCIAPI::send_commandSetOrder(int order) const {
 
 void
 TraCIAPI::createCommand(int cmdID, int varID, const std::string& objID, tcpip::Storage* add) const {
+    if (myProfiling) {
+        myProfileCommand = cmdID;
+        myProfileVariable = varID;
+        myProfileStart = std::chrono::steady_clock::now();
+    }
     myOutput.reset();
+    writeCommand(myOutput, cmdID, varID, objID, add);
+}
+
+
+void
+TraCIAPI::writeCommand(tcpip::Storage& out, int cmdID, int varID, const std::string& objID, tcpip::Storage* add) {
     // command length
     int length = 1 + 1 + 1 + 4 + (int) objID.length();
     if (add != nullptr) {
         length += (int)add->size();
     }
     if (length <= 255) {
-        myOutput.writeUnsignedByte(length);
+        out.writeUnsignedByte(length);
     } else {
-        myOutput.writeUnsignedByte(0);
-        myOutput.writeInt(length + 4);
+        out.writeUnsignedByte(0);
+        out.writeInt(length + 4);
     }
-    myOutput.writeUnsignedByte(cmdID);
-    myOutput.writeUnsignedByte(varID);
-    myOutput.writeString(objID);
+    out.writeUnsignedByte(cmdID);
+    out.writeUnsignedByte(varID);
+    out.writeString(objID);
     // additional values
     if (add != nullptr) {
-        myOutput.writeStorage(*add);
+        out.writeStorage(*add);
     }
 }
 
@@ -242,11 +256,18 @@ TraCIAPI::send_commandSubscribeObjectContext(int domID, const std::string& objID
 void
 TraCIAPI::check_resultState(tcpip::Storage& inMsg, int command, bool ignoreCommandId, std::string* acknowledgement) const {
     mySocket->receiveExact(inMsg);
+    read_resultState(inMsg, command, ignoreCommandId, acknowledgement);
+}
+
+
+void
+TraCIAPI::read_resultState(tcpip::Storage& inMsg, int command, bool ignoreCommandId, std::string* acknowledgement) const {
     int cmdLength;
     int cmdId;
     int resultType;
     int cmdStart;
-    std::string msg;
+    // only copied out of the message if it is reported
+    tcpip::Storage::StringRef msg;
     try {
         cmdStart = inMsg.position();
         cmdLength = inMsg.readUnsignedByte();
@@ -255,22 +276,22 @@ TraCIAPI::check_resultState(tcpip::Storage& inMsg, int command, bool ignoreComma
             throw libsumo::TraCIException("#Error: received status response to command: " + toString(cmdId) + " but expected: " + toString(command));
         }
         resultType = inMsg.readUnsignedByte();
-        msg = inMsg.readString();
+        msg = inMsg.readStringRef();
     } catch (std::invalid_argument&) {
         throw libsumo::TraCIException("#Error: an exception was thrown while reading result state message");
     }
     switch (resultType) {
         case libsumo::RTYPE_ERR:
-            throw libsumo::TraCIException(".. Answered with error to command (" + toString(command) + "), [description: " + msg + "]");
+            throw libsumo::TraCIException(".. Answered with error to command (" + toString(command) + "), [description: " + msg.str() + "]");
         case libsumo::RTYPE_NOTIMPLEMENTED:
-            throw libsumo::TraCIException(".. Sent command is not implemented (" + toString(command) + "), [description: " + msg + "]");
+            throw libsumo::TraCIException(".. Sent command is not implemented (" + toString(command) + "), [description: " + msg.str() + "]");
         case libsumo::RTYPE_OK:
             if (acknowledgement != nullptr) {
-                (*acknowledgement) = ".. Command acknowledged (" + toString(command) + "), [description: " + msg + "]";
+                (*acknowledgement) = ".. Command acknowledged (" + toString(command) + "), [description: " + msg.str() + "]";
             }
             break;
         default:
-            throw libsumo::TraCIException(".. Answered with unknown result code(" + toString(resultType) + ") to command(" + toString(command) + "), [description: " + msg + "]");
+            throw libsumo::TraCIException(".. Answered with unknown result code(" + toString(resultType) + ") to command(" + toString(command) + "), [description: " + msg.str() + "]");
     }
     if ((cmdStart + cmdLength) != (int) inMsg.position()) {
         throw libsumo::TraCIException("#Error: command at position " + toString(cmdStart) + " has wrong length");
@@ -292,7 +313,7 @@ TraCIAPI::check_commandGetResult(tcpip::Storage& inMsg, int command, int expecte
     if (expectedType >= 0) {
         // not called from the TraCITestClient but from within the TraCIAPI
         inMsg.readUnsignedByte(); // variableID
-        inMsg.readString(); // objectID
+        inMsg.readStringRef(); // objectID
         int valueDataType = inMsg.readUnsignedByte();
         if (valueDataType != expectedType) {
             throw libsumo::TraCIException("Expected " + toString(expectedType) + " but got " + toString(valueDataType));
@@ -309,6 +330,9 @@ TraCIAPI::processGet(int command, int expectedType, bool ignoreCommandId) {
         myInput.reset();
         check_resultState(myInput, command, ignoreCommandId);
         check_commandGetResult(myInput, command, expectedType, ignoreCommandId);
+        if (myProfiling) {
+            recordProfile(myProfilePhase, myProfileCommand, myProfileVariable, myProfileStart);
+        }
         return true;
     }
     return false;
@@ -321,6 +345,9 @@ TraCIAPI::processSet(int command) {
         mySocket->sendExact(myOutput);
         myInput.reset();
         check_resultState(myInput, command);
+        if (myProfiling) {
+            recordProfile(myProfilePhase, myProfileCommand, myProfileVariable, myProfileStart);
+        }
         return true;
     }
     return false;
@@ -430,10 +457,7 @@ TraCIAPI::getStringVector(int cmd, int var, const std::string& id, tcpip::Storag
     std::vector<std::string> r;
     createCommand(cmd, var, id, add);
     if (processGet(cmd, libsumo::TYPE_STRINGLIST)) {
-        const int size = myInput.readInt();
-        for (int i = 0; i < size; ++i) {
-            r.push_back(myInput.readString());
-        }
+        myInput.readStringList(r);
     }
     return r;
 }
@@ -548,10 +572,7 @@ TraCIAPI::readVariables(tcpip::Storage& inMsg, const std::string& objectID, int
                     break;
                 case libsumo::TYPE_STRINGLIST: {
                     auto sl = std::make_shared<libsumo::TraCIStringList>();
-                    int n = inMsg.readInt();
-                    for (int i = 0; i < n; ++i) {
-                        sl->value.push_back(inMsg.readString());
-                    }
+                    inMsg.readStringList(sl->value);
                     into[objectID][variableID] = sl;
                 }
                 break;
@@ -571,7 +592,35 @@ TraCIAPI::readVariables(tcpip::Storage& inMsg, const std::string& objectID, int
 
 
 void
-TraCIAPI::readVariableSubscription(int cmdId, tcpip::Storage& inMsg) {
+TraCIAPI::readVariables(tcpip::Storage& inMsg, int slot, int variableCount, SubscriptionStore& into) {
+    while (variableCount > 0) {
+        const int variableID = inMsg.readUnsignedByte();
+        const int status = inMsg.readUnsignedByte();
+        const int type = inMsg.readUnsignedByte();
+        if (status != libsumo::RTYPE_OK) {
+            throw libsumo::TraCIException("Subscription response error: variableID=" + toString(variableID) + " status=" + toString(status));
+        }
+        into.readValue(slot, variableID, type, inMsg);
+        variableCount--;
+    }
+}
+
+
+void
+TraCIAPI::readVariableSubscription(int cmdId, tcpip::Storage& inMsg, bool stepResult) {
+    if (myUseSubscriptionStore) {
+        inMsg.readString(mySubscriptionObjectID);
+        const int variableCount = inMsg.readUnsignedByte();
+        if (!stepResult) {
+            // the store only holds step responses, the immediate result of a subscribe is read past it
+            SubscriptionStore skipped;
+            readVariables(inMsg, skipped.update(mySubscriptionObjectID), variableCount, skipped);
+            return;
+        }
+        SubscriptionStore& store = myDomains[cmdId]->getModifiableSubscriptionStore();
+        readVariables(inMsg, store.update(mySubscriptionObjectID), variableCount, store);
+        return;
+    }
     const std::string objectID = inMsg.readString();
     const int variableCount = inMsg.readUnsignedByte();
     readVariables(inMsg, objectID, variableCount, myDomains[cmdId]->getModifiableSubscriptionResults());
@@ -579,7 +628,32 @@ TraCIAPI::readVariableSubscription(int cmdId, tcpip::Storage& inMsg) {
 
 
 void
-TraCIAPI::readContextSubscription(int cmdId, tcpip::Storage& inMsg) {
+TraCIAPI::readContextSubscription(int cmdId, tcpip::Storage& inMsg, bool stepResult) {
+    if (myUseSubscriptionStore) {
+        inMsg.readString(mySubscriptionContextID);
+        inMsg.readUnsignedByte(); // context domain
+        const int variableCount = inMsg.readUnsignedByte();
+        int numObjects = inMsg.readInt();
+        if (!stepResult) {
+            // the store only holds step responses, the immediate result of a subscribe is read past it
+            SubscriptionStore skipped;
+            while (numObjects > 0) {
+                inMsg.readString(mySubscriptionObjectID);
+                readVariables(inMsg, skipped.update(mySubscriptionObjectID), variableCount, skipped);
+                numObjects--;
+            }
+            return;
+        }
+        SubscriptionStore& store = myDomains[cmdId]->getModifiableContextSubscriptionStore();
+        store.setContext(&mySubscriptionContextID);
+        while (numObjects > 0) {
+            inMsg.readString(mySubscriptionObjectID);
+            readVariables(inMsg, store.update(mySubscriptionObjectID), variableCount, store);
+            numObjects--;
+        }
+        store.setContext(nullptr);
+        return;
+    }
     const std::string contextID = inMsg.readString();
     inMsg.readUnsignedByte(); // context domain
     const int variableCount = inMsg.readUnsignedByte();
@@ -595,12 +669,30 @@ TraCIAPI::readContextSubscription(int cmdId, tcpip::Storage& inMsg) {
 
 void
 TraCIAPI::simulationStep(double time) {
+    std::chrono::steady_clock::time_point start;
+    if (myProfiling) {
+        start = std::chrono::steady_clock::now();
+    }
     send_commandSimulationStep(time);
-    tcpip::Storage inMsg;
-    check_resultState(inMsg, libsumo::CMD_SIMSTEP);
+    // reuse the input buffer, a step response can be large with many subscriptions
+    myInput.reset();
+    check_resultState(myInput, libsumo::CMD_SIMSTEP);
+    readSimulationStepResults(myInput);
+    if (myProfiling) {
+        recordProfile(myProfilePhase, libsumo::CMD_SIMSTEP, -1, start);
+    }
+}
+
 
-    for (auto it : myDomains) {
-        it.second->clearSubscriptionResults();
+void
+TraCIAPI::readSimulationStepResults(tcpip::Storage& inMsg) {
+    for (auto& it : myDomains) {
+        if (myUseSubscriptionStore) {
+            it.second->getModifiableSubscriptionStore().beginUpdate();
+            it.second->getModifiableContextSubscriptionStore().beginUpdate();
+        } else {
+            it.second->clearSubscriptionResults();
+        }
     }
     int numSubs = inMsg.readInt();
     while (numSubs > 0) {
@@ -612,6 +704,430 @@ TraCIAPI::simulationStep(double time) {
         }
         numSubs--;
     }
+    if (myUseSubscriptionStore) {
+        for (auto& it : myDomains) {
+            it.second->getModifiableSubscriptionStore().endUpdate();
+            it.second->getModifiableContextSubscriptionStore().endUpdate();
+        }
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// TraCIAPI::SubscriptionStore-methods
+// ---------------------------------------------------------------------------
+TraCIAPI::SubscriptionStore::SubscriptionStore() :
+    myContext(nullptr),
+    myUpdate(1) {
+    std::fill(myColumnOf, myColumnOf + 256, -1);
+}
+
+
+int
+TraCIAPI::SubscriptionStore::getSlot(const std::string& objID) const {
+    auto it = mySlots.find(objID);
+    if (it == mySlots.end() || myIncludedIn[it->second] != myUpdate) {
+        return -1;
+    }
+    return it->second;
+}
+
+
+const std::vector<int>&
+TraCIAPI::SubscriptionStore::getContextSlots(const std::string& contextID) const {
+    static const std::vector<int> none;
+    auto it = myContexts.find(contextID);
+    return it == myContexts.end() ? none : it->second;
+}
+
+
+bool
+TraCIAPI::SubscriptionStore::has(int slot, int variable) const {
+    const int column = myColumnOf[variable];
+    return column >= 0 && slot < (int)myColumns[column].readIn.size() && myColumns[column].readIn[slot] == myIncludedIn[slot];
+}
+
+
+double
+TraCIAPI::SubscriptionStore::getDouble(int slot, int variable) const {
+    return has(slot, variable) ? myColumns[myColumnOf[variable]].doubles[slot] : libsumo::INVALID_DOUBLE_VALUE;
+}
+
+
+int
+TraCIAPI::SubscriptionStore::getInt(int slot, int variable) const {
+    return has(slot, variable) ? myColumns[myColumnOf[variable]].ints[slot] : libsumo::INVALID_INT_VALUE;
+}
+
+
+const std::string&
+TraCIAPI::SubscriptionStore::getString(int slot, int variable) const {
+    static const std::string none;
+    return has(slot, variable) ? myColumns[myColumnOf[variable]].strings[slot] : none;
+}
+
+
+const std::vector<std::string>&
+TraCIAPI::SubscriptionStore::getStringList(int slot, int variable) const {
+    static const std::vector<std::string> none;
+    return has(slot, variable) ? myColumns[myColumnOf[variable]].lists[slot] : none;
+}
+
+
+libsumo::TraCIPosition
+TraCIAPI::SubscriptionStore::getPosition(int slot, int variable) const {
+    libsumo::TraCIPosition p;
+    if (has(slot, variable)) {
+        const double* v = &myColumns[myColumnOf[variable]].doubles[3 * slot];
+        p.x = v[0];
+        p.y = v[1];
+        p.z = v[2];
+    }
+    return p;
+}
+
+
+libsumo::TraCIColor
+TraCIAPI::SubscriptionStore::getColor(int slot, int variable) const {
+    if (!has(slot, variable)) {
+        return libsumo::TraCIColor();
+    }
+    const int c = myColumns[myColumnOf[variable]].ints[slot];
+    return libsumo::TraCIColor(c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff, (c >> 24) & 0xff);
+}
+
+
+void
+TraCIAPI::SubscriptionStore::beginUpdate() {
+    myUpdate++;
+    myPrevious.swap(myUpdated);
+    myUpdated.clear();
+    for (auto& it : myContexts) {
+        it.second.clear();
+    }
+}
+
+
+void
+TraCIAPI::SubscriptionStore::endUpdate() {
+    for (int slot : myPrevious) {
+        if (myIncludedIn[slot] != myUpdate) {
+            mySlots.erase(myIDs[slot]);
+            myFree.push_back(slot);
+        }
+    }
+    myPrevious.clear();
+}
+
+
+int
+TraCIAPI::SubscriptionStore::update(const std::string& objID) {
+    int slot;
+    auto it = mySlots.find(objID);
+    if (it != mySlots.end()) {
+        slot = it->second;
+    } else {
+        if (myFree.empty()) {
+            slot = (int)myIDs.size();
+            myIDs.push_back(objID);
+            myIncludedIn.push_back(0);
+        } else {
+            slot = myFree.back();
+            myFree.pop_back();
+            myIDs[slot] = objID;
+        }
+        mySlots[objID] = slot;
+    }
+    // objects around several context objects are read once per context
+    if (myIncludedIn[slot] != myUpdate) {
+        myIncludedIn[slot] = myUpdate;
+        myUpdated.push_back(slot);
+    }
+    if (myContext != nullptr) {
+        myContext->push_back(slot);
+    }
+    return slot;
+}
+
+
+void
+TraCIAPI::SubscriptionStore::setContext(const std::string* contextID) {
+    myContext = contextID == nullptr ? nullptr : &myContexts[*contextID];
+}
+
+
+void
+TraCIAPI::SubscriptionStore::readValue(int slot, int variable, int type, tcpip::Storage& inMsg) {
+    if (myColumnOf[variable] < 0) {
+        myColumnOf[variable] = (int)myColumns.size();
+        myColumns.push_back(Column());
+        myColumns.back().type = type;
+    }
+    Column& column = myColumns[myColumnOf[variable]];
+    const bool position = type == libsumo::POSITION_2D || type == libsumo::POSITION_3D;
+    if (type != column.type && !(position && (column.type == libsumo::POSITION_2D || column.type == libsumo::POSITION_3D))) {
+        throw libsumo::TraCIException("Subscription type of variable " + toString(variable) + " changed to " + toString(type));
+    }
+    if (column.readIn.size() < myIDs.size()) {
+        // grow with the slots
+        const std::size_t size = myIDs.size();
+        column.readIn.resize(size, 0);
+        switch (type) {
+            case libsumo::TYPE_DOUBLE:
+                column.doubles.resize(size);
+                break;
+            case libsumo::POSITION_2D:
+            case libsumo::POSITION_3D:
+                column.doubles.resize(3 * size);
+                break;
+            case libsumo::TYPE_INTEGER:
+            case libsumo::TYPE_COLOR:
+                column.ints.resize(size);
+                break;
+            case libsumo::TYPE_STRING:
+                column.strings.resize(size);
+                break;
+            case libsumo::TYPE_STRINGLIST:
+                column.lists.resize(size);
+                break;
+            default:
+                break;
+        }
+    }
+    column.readIn[slot] = myUpdate;
+    switch (type) {
+        case libsumo::TYPE_DOUBLE:
+            column.doubles[slot] = inMsg.readDouble();
+            break;
+        case libsumo::POSITION_2D:
+            column.doubles[3 * slot] = inMsg.readDouble();
+            column.doubles[3 * slot + 1] = inMsg.readDouble();
+            column.doubles[3 * slot + 2] = 0.;
+            break;
+        case libsumo::POSITION_3D:
+            column.doubles[3 * slot] = inMsg.readDouble();
+            column.doubles[3 * slot + 1] = inMsg.readDouble();
+            column.doubles[3 * slot + 2] = inMsg.readDouble();
+            break;
+        case libsumo::TYPE_INTEGER:
+            column.ints[slot] = inMsg.readInt();
+            break;
+        case libsumo::TYPE_COLOR: {
+            int c = inMsg.readUnsignedByte();
+            c |= inMsg.readUnsignedByte() << 8;
+            c |= inMsg.readUnsignedByte() << 16;
+            c |= inMsg.readUnsignedByte() << 24;
+            column.ints[slot] = c;
+            break;
+        }
+        case libsumo::TYPE_STRING:
+            inMsg.readString(column.strings[slot]);
+            break;
+        case libsumo::TYPE_STRINGLIST:
+            inMsg.readStringList(column.lists[slot]);
+            break;
+        default:
+            throw libsumo::TraCIException("Unimplemented subscription type: " + toString(type));
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// TraCIAPI pipelined requests
+// ---------------------------------------------------------------------------
+namespace {
+int readIntValue(tcpip::Storage& inMsg) {
+    return inMsg.readInt();
+}
+
+double readDoubleValue(tcpip::Storage& inMsg) {
+    return inMsg.readDouble();
+}
+
+std::string readStringValue(tcpip::Storage& inMsg) {
+    return inMsg.readString();
+}
+
+std::vector<std::string> readStringVectorValue(tcpip::Storage& inMsg) {
+    std::vector<std::string> r;
+    inMsg.readStringList(r);
+    return r;
+}
+}
+
+
+template <class T>
+std::future<T>
+TraCIAPI::queueGet(int cmd, int var, const std::string& id, tcpip::Storage* add, int expectedType, T(*read)(tcpip::Storage&)) {
+    writeCommand(myQueueOutput, cmd, var, id, add);
+    std::shared_ptr<std::promise<T> > promise = std::make_shared<std::promise<T> >();
+    QueuedCommand queued;
+    queued.command = cmd;
+    queued.variable = var;
+    queued.expectedType = expectedType;
+    profileQueued(queued);
+    queued.decode = [promise, read](tcpip::Storage & inMsg) {
+        promise->set_value(read(inMsg));
+    };
+    queued.fail = [promise](std::exception_ptr e) {
+        promise->set_exception(e);
+    };
+    myQueue.push_back(queued);
+    return promise->get_future();
+}
+
+
+std::future<void>
+TraCIAPI::queueState(int command, int variable, std::function<void(tcpip::Storage&)> onResult) {
+    std::shared_ptr<std::promise<void> > promise = std::make_shared<std::promise<void> >();
+    QueuedCommand queued;
+    queued.command = command;
+    queued.variable = variable;
+    queued.expectedType = -1;
+    profileQueued(queued);
+    queued.decode = [promise, onResult](tcpip::Storage & inMsg) {
+        if (onResult) {
+            onResult(inMsg);
+        }
+        promise->set_value();
+    };
+    queued.fail = [promise](std::exception_ptr e) {
+        promise->set_exception(e);
+    };
+    myQueue.push_back(queued);
+    return promise->get_future();
+}
+
+
+std::future<int>
+TraCIAPI::asyncGetInt(int cmd, int var, const std::string& id, tcpip::Storage* add) {
+    return queueGet(cmd, var, id, add, libsumo::TYPE_INTEGER, readIntValue);
+}
+
+
+std::future<double>
+TraCIAPI::asyncGetDouble(int cmd, int var, const std::string& id, tcpip::Storage* add) {
+    return queueGet(cmd, var, id, add, libsumo::TYPE_DOUBLE, readDoubleValue);
+}
+
+
+std::future<std::string>
+TraCIAPI::asyncGetString(int cmd, int var, const std::string& id, tcpip::Storage* add) {
+    return queueGet(cmd, var, id, add, libsumo::TYPE_STRING, readStringValue);
+}
+
+
+std::future<std::vector<std::string> >
+TraCIAPI::asyncGetStringVector(int cmd, int var, const std::string& id, tcpip::Storage* add) {
+    return queueGet(cmd, var, id, add, libsumo::TYPE_STRINGLIST, readStringVectorValue);
+}
+
+
+std::future<void>
+TraCIAPI::asyncSet(int cmd, int var, const std::string& id, tcpip::Storage* add) {
+    writeCommand(myQueueOutput, cmd, var, id, add);
+    return queueState(cmd, var);
+}
+
+
+std::future<void>
+TraCIAPI::asyncSimulationStep(double time) {
+    // command length
+    myQueueOutput.writeUnsignedByte(1 + 1 + 8);
+    // command id
+    myQueueOutput.writeUnsignedByte(libsumo::CMD_SIMSTEP);
+    myQueueOutput.writeDouble(time);
+    return queueState(libsumo::CMD_SIMSTEP, -1, [this](tcpip::Storage & inMsg) {
+        readSimulationStepResults(inMsg);
+    });
+}
+
+
+void
+TraCIAPI::flush() {
+    sendQueued();
+    receiveQueued(true);
+}
+
+
+void
+TraCIAPI::sendQueued() {
+    if (myQueue.empty()) {
+        return;
+    }
+    if (!myInFlight.empty()) {
+        throw libsumo::TraCIException("#Error: queued commands sent before the previous response was received");
+    }
+    // commands queued from now on go into the next message
+    myInFlight.swap(myQueue);
+    try {
+        if (mySocket == nullptr) {
+            throw tcpip::SocketException("Socket is not initialised");
+        }
+        mySocket->sendExact(myQueueOutput);
+        myQueueOutput.reset();
+    } catch (...) {
+        myQueueOutput.reset();
+        std::vector<QueuedCommand> failed;
+        failed.swap(myInFlight);
+        for (QueuedCommand& queued : failed) {
+            queued.fail(std::current_exception());
+        }
+        throw;
+    }
+}
+
+
+bool
+TraCIAPI::receiveQueued(bool wait) {
+    if (myInFlight.empty()) {
+        return true;
+    }
+    std::vector<QueuedCommand> queue;
+    try {
+        if (wait) {
+            mySocket->receiveExact(myInput);
+        } else if (!mySocket->tryReceiveExact(myInput)) {
+            return false;
+        }
+    } catch (...) {
+        queue.swap(myInFlight);
+        for (QueuedCommand& queued : queue) {
+            queued.fail(std::current_exception());
+        }
+        throw;
+    }
+    queue.swap(myInFlight);
+    std::vector<QueuedCommand>::iterator it = queue.begin();
+    try {
+        // the server answers every command of the message in order
+        for (; it != queue.end(); ++it) {
+            try {
+                read_resultState(myInput, it->command);
+            } catch (libsumo::TraCIException&) {
+                // a failed command has no result, the next one follows directly
+                it->fail(std::current_exception());
+                if (myProfiling) {
+                    recordProfile(it->phase, it->command, it->variable, it->queued);
+                }
+                continue;
+            }
+            if (it->expectedType >= 0) {
+                check_commandGetResult(myInput, it->command, it->expectedType);
+            }
+            it->decode(myInput);
+            if (myProfiling) {
+                recordProfile(it->phase, it->command, it->variable, it->queued);
+            }
+        }
+    } catch (...) {
+        // the rest of the response cannot be interpreted any more
+        for (; it != queue.end(); ++it) {
+            it->fail(std::current_exception());
+        }
+        throw;
+    }
+    return true;
 }
 
 
@@ -633,6 +1149,47 @@ TraCIAPI::load(const std::vector<std::string>& args) {
 }
 
 
+// ---------------------------------------------------------------------------
+// TraCIAPI profiling
+// ---------------------------------------------------------------------------
+void
+TraCIAPI::profileQueued(QueuedCommand& queued) const {
+    queued.phase = myProfilePhase;
+    if (myProfiling) {
+        queued.queued = std::chrono::steady_clock::now();
+    }
+}
+
+
+void
+TraCIAPI::recordProfile(int phase, int command, int variable, std::chrono::steady_clock::time_point start) const {
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    ProfileEntry& entry = myProfile[std::make_tuple(phase, command, variable)];
+    entry.calls++;
+    entry.totalNs += ns;
+    if (ns > entry.maxNs) {
+        entry.maxNs = ns;
+    }
+}
+
+
+void
+TraCIAPI::writeProfile(std::ostream& out, const std::vector<std::string>& phaseNames) const {
+    out << "phase,command,variable,calls,total_ms,mean_us,max_us\n";
+    for (const auto& it : myProfile) {
+        const int phase = std::get<0>(it.first);
+        const int variable = std::get<2>(it.first);
+        const ProfileEntry& entry = it.second;
+        out << (phase >= 0 && phase < (int)phaseNames.size() ? phaseNames[phase] : "other") << ","
+            << "0x" << std::hex << std::get<1>(it.first) << ",";
+        if (variable >= 0) {
+            out << "0x" << variable;
+        }
+        out << std::dec << "," << entry.calls << "," << entry.totalNs / 1e6 << ","
+            << entry.totalNs / entry.calls / 1e3 << "," << entry.maxNs / 1e3 << "\n";
+    }
+}
+
 // ---------------------------------------------------------------------------
 // TraCIAPI::EdgeScope-methods
 // ---------------------------------------------------------------------------
@@ -1817,6 +2374,16 @@ TraCIAPI::SimulationScope::getDistanceRoad(const std::string& edgeID1, double po
 }
 
 
+void
+TraCIAPI::SimulationScope::saveState(const std::string& fileName) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_STRING);
+    content.writeString(fileName);
+    myParent.createCommand(libsumo::CMD_SET_SIM_VARIABLE, libsumo::CMD_SAVE_SIMSTATE, "", &content);
+    myParent.processSet(libsumo::CMD_SET_SIM_VARIABLE);
+}
+
+
 // ---------------------------------------------------------------------------
 // TraCIAPI::TrafficLightScope-methods
 // ---------------------------------------------------------------------------
@@ -2769,6 +3336,29 @@ TraCIAPI::VehicleScope::add(const std::string& vehicleID,
         depart = toString(myParent.simulation.getCurrentTime() / 1000.0);
     }
     tcpip::Storage content;
+    writeAddContent(content, routeID, typeID, depart, departLane, departPos, departSpeed, arrivalLane, arrivalPos,
+                    arrivalSpeed, fromTaz, toTaz, line, personCapacity, personNumber);
+    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::ADD_FULL, vehicleID, &content);
+    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
+}
+
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncAdd(const std::string& vehicleID, const std::string& routeID, const std::string& typeID,
+                                 const std::string& depart, const std::string& departLane, const std::string& departPos,
+                                 const std::string& departSpeed) const {
+    tcpip::Storage content;
+    writeAddContent(content, routeID, typeID, depart, departLane, departPos, departSpeed, "current", "max", "current", "", "", "", 0, 0);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::ADD_FULL, vehicleID, &content);
+}
+
+
+void
+TraCIAPI::VehicleScope::writeAddContent(tcpip::Storage& content, const std::string& routeID, const std::string& typeID,
+                                        const std::string& depart, const std::string& departLane, const std::string& departPos,
+                                        const std::string& departSpeed, const std::string& arrivalLane, const std::string& arrivalPos,
+                                        const std::string& arrivalSpeed, const std::string& fromTaz, const std::string& toTaz,
+                                        const std::string& line, int personCapacity, int personNumber) {
     content.writeUnsignedByte(libsumo::TYPE_COMPOUND);
     content.writeInt(14);
     content.writeUnsignedByte(libsumo::TYPE_STRING);
@@ -2802,9 +3392,6 @@ TraCIAPI::VehicleScope::add(const std::string& vehicleID,
     content.writeInt(personCapacity);
     content.writeUnsignedByte(libsumo::TYPE_INTEGER);
     content.writeInt(personNumber);
-
-    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::ADD_FULL, vehicleID, &content);
-    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
 }
 
 
@@ -2912,14 +3499,26 @@ TraCIAPI::VehicleScope::rerouteTraveltime(const std::string& vehicleID, bool cur
 void
 TraCIAPI::VehicleScope::moveTo(const std::string& vehicleID, const std::string& laneID, double position) const {
     tcpip::Storage content;
+    writeMoveToContent(content, laneID, position);
+    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_MOVE_TO, vehicleID, &content);
+    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncMoveTo(const std::string& vehicleID, const std::string& laneID, double position) const {
+    tcpip::Storage content;
+    writeMoveToContent(content, laneID, position);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_MOVE_TO, vehicleID, &content);
+}
+
+void
+TraCIAPI::VehicleScope::writeMoveToContent(tcpip::Storage& content, const std::string& laneID, double position) {
     content.writeUnsignedByte(libsumo::TYPE_COMPOUND);
     content.writeInt(2);
     content.writeUnsignedByte(libsumo::TYPE_STRING);
     content.writeString(laneID);
     content.writeUnsignedByte(libsumo::TYPE_DOUBLE);
     content.writeDouble(position);
-    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_MOVE_TO, vehicleID, &content);
-    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
 }
 
 void
@@ -2947,14 +3546,26 @@ TraCIAPI::VehicleScope::moveToXY(const std::string& vehicleID, const std::string
 void
 TraCIAPI::VehicleScope::slowDown(const std::string& vehicleID, double speed, double duration) const {
     tcpip::Storage content;
+    writeSlowDownContent(content, speed, duration);
+    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::CMD_SLOWDOWN, vehicleID, &content);
+    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncSlowDown(const std::string& vehicleID, double speed, double duration) const {
+    tcpip::Storage content;
+    writeSlowDownContent(content, speed, duration);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::CMD_SLOWDOWN, vehicleID, &content);
+}
+
+void
+TraCIAPI::VehicleScope::writeSlowDownContent(tcpip::Storage& content, double speed, double duration) {
     content.writeUnsignedByte(libsumo::TYPE_COMPOUND);
     content.writeInt(2);
     content.writeUnsignedByte(libsumo::TYPE_DOUBLE);
     content.writeDouble(speed);
     content.writeUnsignedByte(libsumo::TYPE_DOUBLE);
     content.writeDouble(duration);
-    myParent.createCommand(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::CMD_SLOWDOWN, vehicleID, &content);
-    myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
 }
 
 void
@@ -2989,6 +3600,46 @@ TraCIAPI::VehicleScope::setSpeed(const std::string& vehicleID, double speed) con
     myParent.processSet(libsumo::CMD_SET_VEHICLE_VARIABLE);
 }
 
+std::future<void>
+TraCIAPI::VehicleScope::asyncSetSpeed(const std::string& vehicleID, double speed) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_DOUBLE);
+    content.writeDouble(speed);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_SPEED, vehicleID, &content);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncRemove(const std::string& vehicleID, char reason) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_BYTE);
+    content.writeUnsignedByte(reason);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::REMOVE, vehicleID, &content);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncSetSpeedFactor(const std::string& vehicleID, double factor) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_DOUBLE);
+    content.writeDouble(factor);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_SPEED_FACTOR, vehicleID, &content);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncSetSpeedMode(const std::string& vehicleID, int mode) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_INTEGER);
+    content.writeInt(mode);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_SPEEDSETMODE, vehicleID, &content);
+}
+
+std::future<void>
+TraCIAPI::VehicleScope::asyncSetLaneChangeMode(const std::string& vehicleID, int mode) const {
+    tcpip::Storage content;
+    content.writeUnsignedByte(libsumo::TYPE_INTEGER);
+    content.writeInt(mode);
+    return myParent.asyncSet(libsumo::CMD_SET_VEHICLE_VARIABLE, libsumo::VAR_LANECHANGE_MODE, vehicleID, &content);
+}
+
 void
 TraCIAPI::VehicleScope::setSpeedMode(const std::string& vehicleID, int mode) const {
     tcpip::Storage content;
@@ -3427,7 +4078,7 @@ TraCIAPI::TraCIScopeWrapper::subscribe(const std::string& objID, const std::vect
     myParent.check_resultState(inMsg, mySubscribeID);
     if (vars.size() > 0) {
         myParent.check_commandGetResult(inMsg, mySubscribeID);
-        myParent.readVariableSubscription(mySubscribeID + 0x10, inMsg);
+        myParent.readVariableSubscription(mySubscribeID + 0x10, inMsg, false);
     }
 }
 
@@ -3438,7 +4089,7 @@ TraCIAPI::TraCIScopeWrapper::subscribeContext(const std::string& objID, int doma
     tcpip::Storage inMsg;
     myParent.check_resultState(inMsg, myContextSubscribeID);
     myParent.check_commandGetResult(inMsg, myContextSubscribeID);
-    myParent.readContextSubscription(myContextSubscribeID + 0x60, inMsg);
+    myParent.readContextSubscription(myContextSubscribeID + 0x60, inMsg, false);
 }
 
 
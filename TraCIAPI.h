@@ -29,7 +29,13 @@
 #include <limits>
 #include <string>
 #include <sstream>
+#include <ostream>
+#include <tuple>
+#include <chrono>
 #include <iomanip>
+#include <functional>
+#include <future>
+#include <unordered_map>
 #include "socket.h"
 #include "TraCIConstants.h"
 #include "TraCIDefs.h"
@@ -96,6 +102,160 @@ public:
     libsumo::TraCIStage getTraCIStage(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
     /// @}
 
+    /// @name Pipelined requests
+    /// Queued commands are sent together in one message by flush(), the responses
+    /// are decoded in order and fulfil the returned futures.
+    /// @{
+    std::future<int> asyncGetInt(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
+    std::future<double> asyncGetDouble(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
+    std::future<std::string> asyncGetString(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
+    std::future<std::vector<std::string> > asyncGetStringVector(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
+    std::future<void> asyncSet(int cmd, int var, const std::string& id, tcpip::Storage* add = 0);
+    /// @brief Queues a simulation step, commands queued after it see the new state
+    std::future<void> asyncSimulationStep(double time = 0);
+
+    /// @brief Returns the number of commands waiting for flush()
+    int getQueuedCount() const {
+        return (int)myQueue.size();
+    }
+
+    /** @brief Sends all queued commands in one message and decodes their responses
+     * Errors reported for single commands are delivered through their futures.
+     * @exception tcpip::SocketException if sending or receiving fails
+     */
+    void flush();
+
+    /** @brief Sends the queued commands without waiting for the response
+     * The response has to be read by receiveQueued() before the next send.
+     */
+    void sendQueued();
+
+    /** @brief Decodes the response to sendQueued()
+     * @param[in] wait Whether to block until the response has arrived
+     * @return false if wait is false and the response is still incomplete
+     */
+    bool receiveQueued(bool wait = true);
+
+    /// @brief Returns the descriptor of the connection (-1 if not connected), e.g. for polling it
+    int getSocketDescriptor() const {
+        return mySocket == nullptr ? -1 : mySocket->get_socket();
+    }
+    /// @}
+
+    /// @name Profiling
+    /// When enabled, every command is counted by command and variable id and its
+    /// round trip is timed (for pipelined commands from queueing to decoding the
+    /// response), attributed to the phase set by the caller.
+    /// @{
+    void setProfiling(bool enabled) {
+        myProfiling = enabled;
+    }
+
+    bool isProfiling() const {
+        return myProfiling;
+    }
+
+    /// @brief Sets the caller phase following commands are attributed to, -1 for none
+    void setProfilePhase(int phase) {
+        myProfilePhase = phase;
+    }
+
+    int getProfilePhase() const {
+        return myProfilePhase;
+    }
+
+    /** @brief Writes calls and round trip times per phase, command and variable as csv
+     * @param[in] out The stream to write to
+     * @param[in] phaseNames Names of the phases, others are reported as "other"
+     */
+    void writeProfile(std::ostream& out, const std::vector<std::string>& phaseNames) const;
+    /// @}
+
+    /** @brief Keeps subscription results in each domain's SubscriptionStore instead of
+     * the libsumo::SubscriptionResults maps, which stay empty while enabled
+     */
+    void setSubscriptionStore(bool enabled) {
+        myUseSubscriptionStore = enabled;
+    }
+
+    bool usesSubscriptionStore() const {
+        return myUseSubscriptionStore;
+    }
+
+    /** @class SubscriptionStore
+     * @brief Subscription results in flat columns, one per subscribed variable
+     *
+     * An object keeps its slot for as long as it is included in the step responses
+     * and its values are overwritten in place. Once the objects and variables have
+     * been seen, reading a step and the accessors below do not allocate.
+     */
+    class SubscriptionStore {
+    public:
+        SubscriptionStore();
+
+        /// @brief The slot of the object in the last step, -1 if it was not included
+        int getSlot(const std::string& objID) const;
+        /// @brief The slots of all objects in the last step, in response order
+        const std::vector<int>& getSlots() const {
+            return myUpdated;
+        }
+        /// @brief The slots of the objects reported around the given context object in the last step
+        const std::vector<int>& getContextSlots(const std::string& contextID) const;
+        const std::string& getID(int slot) const {
+            return myIDs[slot];
+        }
+        /// @brief Whether the variable of the object was included in the last step
+        bool has(int slot, int variable) const;
+
+        /// @name Values, invalid values if the variable was not included
+        /// @{
+        double getDouble(int slot, int variable) const;
+        int getInt(int slot, int variable) const;
+        const std::string& getString(int slot, int variable) const;
+        const std::vector<std::string>& getStringList(int slot, int variable) const;
+        libsumo::TraCIPosition getPosition(int slot, int variable) const;
+        libsumo::TraCIColor getColor(int slot, int variable) const;
+        /// @}
+
+        // the following are only for internal use
+        /// @brief Starts the results of a new step
+        void beginUpdate();
+        /// @brief Frees the slots of objects missing from the step
+        void endUpdate();
+        /// @brief Returns the slot the results of the object are read into
+        int update(const std::string& objID);
+        /// @brief Records following updates as reported around the context object, nullptr to stop
+        void setContext(const std::string* contextID);
+        /// @brief Reads a value of the given type into the object's column for the variable
+        void readValue(int slot, int variable, int type, tcpip::Storage& inMsg);
+
+    private:
+        struct Column {
+            int type;
+            /// @brief one value per slot, three for positions
+            std::vector<double> doubles;
+            /// @brief integers and packed colors
+            std::vector<int> ints;
+            std::vector<std::string> strings;
+            std::vector<std::vector<std::string> > lists;
+            /// @brief The update of each slot the value was read in
+            std::vector<unsigned int> readIn;
+        };
+        /// @brief The column of a variable, -1 if it has not been seen
+        int myColumnOf[256];
+        std::vector<Column> myColumns;
+        std::unordered_map<std::string, int> mySlots;
+        std::vector<std::string> myIDs;
+        /// @brief The last update each slot was included in
+        std::vector<unsigned int> myIncludedIn;
+        std::vector<int> myFree;
+        std::vector<int> myUpdated;
+        std::vector<int> myPrevious;
+        std::unordered_map<std::string, std::vector<int> > myContexts;
+        std::vector<int>* myContext;
+        unsigned int myUpdate;
+    };
+
     const tcpip::Storage& getCommandStorage() const {
         return myOutput;
     }
@@ -136,7 +296,21 @@ public:
         const libsumo::ContextSubscriptionResults getAllContextSubscriptionResults() const;
         const libsumo::SubscriptionResults getContextSubscriptionResults(const std::string& objID) const;
 
+        /// @brief The results if the parent uses subscription stores
+        const SubscriptionStore& getSubscriptionStore() const {
+            return mySubscriptionStore;
+        }
+        const SubscriptionStore& getContextSubscriptionStore() const {
+            return myContextSubscriptionStore;
+        }
+
         // the following are only for internal use
+        SubscriptionStore& getModifiableSubscriptionStore() {
+            return mySubscriptionStore;
+        }
+        SubscriptionStore& getModifiableContextSubscriptionStore() {
+            return myContextSubscriptionStore;
+        }
         void clearSubscriptionResults();
         libsumo::SubscriptionResults& getModifiableSubscriptionResults();
         libsumo::SubscriptionResults& getModifiableContextSubscriptionResults(const std::string& objID);
@@ -151,6 +325,8 @@ public:
         int myContextSubscribeID;
         libsumo::SubscriptionResults mySubscriptionResults;
         libsumo::ContextSubscriptionResults myContextSubscriptionResults;
+        SubscriptionStore mySubscriptionStore;
+        SubscriptionStore myContextSubscriptionStore;
 
 
     private:
@@ -538,6 +714,9 @@ public:
         double getDistance2D(double x1, double y1, double x2, double y2, bool isGeo = false, bool isDriving = false);
         double getDistanceRoad(const std::string& edgeID1, double pos1, const std::string& edgeID2, double pos2, bool isDriving = false);
 
+        /// @brief Saves the simulation state to the given file (on the server's side), it can be loaded with --load-state
+        void saveState(const std::string& fileName) const;
+
 
     private:
         /// @brief invalidated copy constructor
@@ -786,6 +965,17 @@ public:
         void slowDown(const std::string& vehicleID, double speed, double duration) const;
         void openGap(const std::string& vehicleID, double newTau, double duration, double changeRate, double maxDecel) const;
         void setSpeed(const std::string& vehicleID, double speed) const;
+        /// @brief pipelined variants, sent on the next flush()
+        std::future<void> asyncAdd(const std::string& vehicleID, const std::string& routeID, const std::string& typeID,
+                                   const std::string& depart, const std::string& departLane, const std::string& departPos,
+                                   const std::string& departSpeed) const;
+        std::future<void> asyncMoveTo(const std::string& vehicleID, const std::string& laneID, double position) const;
+        std::future<void> asyncSlowDown(const std::string& vehicleID, double speed, double duration) const;
+        std::future<void> asyncSetSpeed(const std::string& vehicleID, double speed) const;
+        std::future<void> asyncRemove(const std::string& vehicleID, char reason = libsumo::REMOVE_VAPORIZED) const;
+        std::future<void> asyncSetSpeedFactor(const std::string& vehicleID, double factor) const;
+        std::future<void> asyncSetSpeedMode(const std::string& vehicleID, int mode) const;
+        std::future<void> asyncSetLaneChangeMode(const std::string& vehicleID, int mode) const;
         void setSpeedMode(const std::string& vehicleID, int mode) const;
         void setStop(const std::string vehicleID, const std::string edgeID, const double endPos = 1.,
                      const int laneIndex = 0, const double duration = std::numeric_limits<double>::max(),
@@ -809,6 +999,17 @@ public:
         /// @}
 
     private:
+        /// @brief writes the ADD_FULL parameters
+        static void writeAddContent(tcpip::Storage& content, const std::string& routeID, const std::string& typeID,
+                                    const std::string& depart, const std::string& departLane, const std::string& departPos,
+                                    const std::string& departSpeed, const std::string& arrivalLane, const std::string& arrivalPos,
+                                    const std::string& arrivalSpeed, const std::string& fromTaz, const std::string& toTaz,
+                                    const std::string& line, int personCapacity, int personNumber);
+        /// @brief writes the VAR_MOVE_TO parameters
+        static void writeMoveToContent(tcpip::Storage& content, const std::string& laneID, double position);
+        /// @brief writes the CMD_SLOWDOWN parameters
+        static void writeSlowDownContent(tcpip::Storage& content, double speed, double duration);
+
         /// @brief invalidated copy constructor
         VehicleScope(const VehicleScope& src);
 
@@ -934,6 +1135,9 @@ protected:
      */
     void createCommand(int cmdID, int varID, const std::string& objID, tcpip::Storage* add = nullptr) const;
 
+    /// @brief Appends a GetVariable / SetVariable command to \p out
+    static void writeCommand(tcpip::Storage& out, int cmdID, int varID, const std::string& objID, tcpip::Storage* add = nullptr);
+
 
     /** @brief Sends a SubscribeVariable request
      * @param[in] domID The domain of the variable
@@ -970,6 +1174,11 @@ protected:
      */
     void check_resultState(tcpip::Storage& inMsg, int command, bool ignoreCommandId = false, std::string* acknowledgement = 0) const;
 
+    /** @brief Validates the result state of a command which has already been received
+     * @see check_resultState
+     */
+    void read_resultState(tcpip::Storage& inMsg, int command, bool ignoreCommandId = false, std::string* acknowledgement = 0) const;
+
     /** @brief Validates the result state of a command
      * @return The command Id
      */
@@ -979,9 +1188,47 @@ protected:
     bool processSet(int command);
     /// @}
 
-    void readVariableSubscription(int cmdId, tcpip::Storage& inMsg);
-    void readContextSubscription(int cmdId, tcpip::Storage& inMsg);
+    /// @brief Reads a subscription result, into the subscription store only if it is part of a step response
+    void readVariableSubscription(int cmdId, tcpip::Storage& inMsg, bool stepResult = true);
+    void readContextSubscription(int cmdId, tcpip::Storage& inMsg, bool stepResult = true);
     void readVariables(tcpip::Storage& inMsg, const std::string& objectID, int variableCount, libsumo::SubscriptionResults& into);
+    void readVariables(tcpip::Storage& inMsg, int slot, int variableCount, SubscriptionStore& into);
+    /// @brief Reads the subscription results following the result state of a simulation step
+    void readSimulationStepResults(tcpip::Storage& inMsg);
+
+    /// @brief A command waiting in myQueueOutput for its response
+    struct QueuedCommand {
+        /// @brief The command id the result state refers to
+        int command;
+        /// @brief The variable id for profiling, -1 if there is none
+        int variable;
+        /// @brief The expected value type of a get command, -1 if there is no result but the state
+        int expectedType;
+        /// @brief The caller phase and queueing time for profiling
+        int phase;
+        std::chrono::steady_clock::time_point queued;
+        /// @brief Reads the value and fulfils the future
+        std::function<void(tcpip::Storage&)> decode;
+        /// @brief Passes an error to the future
+        std::function<void(std::exception_ptr)> fail;
+    };
+
+    /// @brief Queues a get command whose value is read by \p read
+    template <class T>
+    std::future<T> queueGet(int cmd, int var, const std::string& id, tcpip::Storage* add, int expectedType, T(*read)(tcpip::Storage&));
+    /// @brief Queues a command answered by its result state only, calling \p onResult after it has been checked
+    std::future<void> queueState(int command, int variable, std::function<void(tcpip::Storage&)> onResult = nullptr);
+    /// @brief Stamps a command being queued for profiling
+    void profileQueued(QueuedCommand& queued) const;
+
+    /// @brief Round trip statistics of one phase, command and variable
+    struct ProfileEntry {
+        long long calls;
+        double totalNs;
+        double maxNs;
+    };
+    /// @brief Counts a command of the given phase started at \p start
+    void recordProfile(int phase, int command, int variable, std::chrono::steady_clock::time_point start) const;
 
     template <class T>
     static inline std::string toString(const T& t, std::streamsize accuracy = PRECISION) {
@@ -1003,6 +1250,27 @@ protected:
     mutable tcpip::Storage myOutput;
     /// @brief The reusable input storage
     mutable tcpip::Storage myInput;
+    /// @brief The commands queued for the next flush
+    std::vector<QueuedCommand> myQueue;
+    /// @brief The message collecting the queued commands
+    tcpip::Storage myQueueOutput;
+    /// @brief The commands sent but not answered yet
+    std::vector<QueuedCommand> myInFlight;
+    /// @brief Whether commands are profiled
+    bool myProfiling;
+    /// @brief The caller phase commands are attributed to
+    int myProfilePhase;
+    /// @brief The blocking command in progress
+    mutable int myProfileCommand;
+    mutable int myProfileVariable;
+    mutable std::chrono::steady_clock::time_point myProfileStart;
+    /// @brief Statistics by phase, command and variable
+    mutable std::map<std::tuple<int, int, int>, ProfileEntry> myProfile;
+    /// @brief Whether subscription results go to the subscription stores
+    bool myUseSubscriptionStore;
+    /// @brief Reused for the object ids of subscription results
+    std::string mySubscriptionObjectID;
+    std::string mySubscriptionContextID;
 };
 
 
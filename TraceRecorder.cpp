@@ -0,0 +1,114 @@
+/**
+TraceRecorder.cpp
+
+Records partition events into per-thread ring buffers, which grow as events
+come in up to the capacity given to enable(). A thread takes the
+registry lock once to register its buffer, after that recording is a plain
+store and an atomic increment. The records are written as a Chrome trace
+(chrome://tracing, ui.perfetto.dev) with one track per partition.
+
+Author: Phillip Taylor
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include "TraceRecorder.h"
+
+std::atomic<bool> TraceRecorder::enabled(false);
+std::size_t TraceRecorder::capacity = 0;
+std::mutex TraceRecorder::buffersLock;
+std::vector<TraceRecorder::buffer_t*> TraceRecorder::buffers;
+std::atomic<int> TraceRecorder::generation(0);
+
+void TraceRecorder::enable(std::size_t records) {
+  std::lock_guard<std::mutex> guard(buffersLock);
+  capacity = std::max(records, (std::size_t)1);
+  enabled = true;
+}
+
+void TraceRecorder::disable() {
+  enabled = false;
+}
+
+TraceRecorder::buffer_t* TraceRecorder::localBuffer() {
+  static thread_local buffer_t* buffer = nullptr;
+  static thread_local int bufferGeneration = -1;
+  if(buffer == nullptr || bufferGeneration != generation) {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    buffer = new buffer_t();
+    buffer->capacity = capacity;
+    buffer->count = 0;
+    buffers.push_back(buffer);
+    bufferGeneration = generation;
+  }
+  return buffer;
+}
+
+void TraceRecorder::add(const char* name, int partition, uint64_t start, uint64_t duration, int value, char type) {
+  buffer_t* buffer = localBuffer();
+  uint64_t n = buffer->count.load(std::memory_order_relaxed);
+  record_t r = {start, duration, name, partition, value, type};
+  // short runs only allocate the records they make
+  if(buffer->records.size() < buffer->capacity)
+    buffer->records.push_back(r);
+  else
+    buffer->records[n % buffer->capacity] = r;
+  buffer->count.store(n+1, std::memory_order_release);
+}
+
+void TraceRecorder::write(const std::string& file) {
+  std::lock_guard<std::mutex> guard(buffersLock);
+  std::vector<record_t> records;
+  for(buffer_t* buffer : buffers) {
+    uint64_t n = buffer->count.load(std::memory_order_acquire);
+    uint64_t size = buffer->records.size();
+    // oldest records have been overwritten if the ring wrapped
+    for(uint64_t i = n > size ? n-size : 0; i<n; i++)
+      records.push_back(buffer->records[i % size]);
+  }
+  std::sort(records.begin(), records.end(), [](const record_t& a, const record_t& b) {
+    return a.start < b.start;
+  });
+
+  std::ofstream out(file);
+  if(!out) {
+    std::cout << "unable to write " << file << std::endl;
+    return;
+  }
+  std::vector<int> partitions;
+  for(record_t& r : records) {
+    if(std::find(partitions.begin(), partitions.end(), r.partition) == partitions.end())
+      partitions.push_back(r.partition);
+  }
+  std::sort(partitions.begin(), partitions.end());
+  uint64_t origin = records.empty() ? 0 : records[0].start;
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  for(int p : partitions) {
+    out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << p
+      << ", \"args\": {\"name\": \"partition " << p << "\"}}";
+    first = false;
+  }
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  for(record_t& r : records) {
+    out << (first ? "" : ",\n") << "{\"name\": \"" << r.name << "\", \"ph\": \"" << r.type
+      << "\", \"pid\": 0, \"tid\": " << r.partition << ", \"ts\": " << (r.start-origin)/1e3;
+    if(r.type == 'X')
+      out << ", \"dur\": " << r.duration/1e3;
+    else
+      out << ", \"s\": \"t\", \"args\": {\"vehicles\": " << r.value << "}";
+    out << "}";
+    first = false;
+  }
+  out << "\n]}\n";
+}
+
+void TraceRecorder::clear() {
+  std::lock_guard<std::mutex> guard(buffersLock);
+  for(buffer_t* buffer : buffers)
+    delete buffer;
+  buffers.clear();
+  generation++;
+}
@@ -0,0 +1,74 @@
+/**
+TraceRecorder.h
+
+Class definition for TraceRecorder.
+
+Author: Phillip Taylor
+*/
+
+#ifndef TRACERECORDER_INCLUDED
+#define TRACERECORDER_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+class TraceRecorder {
+  private:
+    struct record_t {
+      uint64_t start;
+      uint64_t duration;
+      const char* name;
+      int partition;
+      int value;
+      // 'X' for a complete event, 'i' for an instant
+      char type;
+    };
+    // ring of the most recent records of one thread, only written by that thread;
+    // grows with the records until it holds capacity of them
+    struct buffer_t {
+      std::vector<record_t> records;
+      std::size_t capacity;
+      std::atomic<uint64_t> count;
+    };
+    static std::atomic<bool> enabled;
+    static std::size_t capacity;
+    static std::mutex buffersLock;
+    static std::vector<buffer_t*> buffers;
+    // incremented by clear() so threads register a new buffer
+    static std::atomic<int> generation;
+    // this thread's buffer, registered on its first record
+    static buffer_t* localBuffer();
+    static void add(const char*, int, uint64_t, uint64_t, int, char);
+
+  public:
+    // start recording, keeping the last given number of records per thread
+    static void enable(std::size_t);
+    // stop recording, records are kept until clear()
+    static void disable();
+    static bool isEnabled() {
+      return enabled.load(std::memory_order_relaxed);
+    }
+    // record a phase of a partition
+    // params: name, partition, start (ns), duration (ns)
+    static void complete(const char* name, int partition, uint64_t start, uint64_t duration) {
+      if(isEnabled())
+        add(name, partition, start, duration, 0, 'X');
+    }
+    // record a point event of a partition with a value (e.g. number of vehicles)
+    // params: name, partition, time (ns), value
+    static void instant(const char* name, int partition, uint64_t time, int value) {
+      if(isEnabled())
+        add(name, partition, time, 0, value, 'i');
+    }
+    // write all records in chrome trace format, one track per partition; call
+    // when recording threads have finished
+    static void write(const std::string&);
+    // drop all records
+    static void clear();
+
+};
+
+#endif
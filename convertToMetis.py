@@ -30,6 +30,8 @@ else:
 
 def get_options(args=sys.argv[1:]):
     optParser = OptionParser()
+    optParser.add_option("-o", "--output-dir", dest="outputDir", default=".",
+                         help="directory for the metis files and partition edge files")
     options, args = optParser.parse_args(args=args)
     options.network = args[0]
     options.parts = args[1]
@@ -52,18 +54,23 @@ def main(options):
         neighbors.append(neighs)
 
     # write metis input file
-    with codecs.open("metisInputFile", 'w', encoding='utf8') as f:
+    metisInput = os.path.join(options.outputDir, "metisInputFile")
+    with codecs.open(metisInput, 'w', encoding='utf8') as f:
         f.write("%s %s\n" % (numNodes, numUndirectedEdges))
         for neighs in neighbors:
             f.write("%s\n" % (" ".join([str(i+1) for i in [nodesDict[n] for n in neighs]])))
 
-    # execute metis
-    subprocess.call(["gpmetis", "-objtype=vol", "-contig", "metisInputFile", options.parts])
+    # execute metis, a single partition holds every node
+    if int(options.parts) > 1:
+        subprocess.call(["gpmetis", "-objtype=vol", "-contig", metisInput, options.parts])
+    else:
+        with codecs.open(metisInput+".part."+options.parts, 'w', encoding='utf8') as f:
+            f.write("0\n" * numNodes)
 
     # get edges corresponding to partitions
     edges = [set() for _ in range(int(options.parts))]
     curr = 0
-    with codecs.open("metisInputFile.part."+options.parts, 'r', encoding='utf8') as f:
+    with codecs.open(metisInput+".part."+options.parts, 'r', encoding='utf8') as f:
         for line in f:
             part = int(line)
             nodeEdges = nodes[curr].getIncoming() + nodes[curr].getOutgoing()
@@ -74,7 +81,7 @@ def main(options):
 
     # write edges of partitions in separate files
     for i in range(len(edges)):
-        with codecs.open("edgesPart"+str(i), 'w', encoding='utf8') as f:
+        with codecs.open(os.path.join(options.outputDir, "edgesPart"+str(i)), 'w', encoding='utf8') as f:
             for eID in edges[i]:
                 f.write("%s\n" % (eID))
 
@@ -0,0 +1,107 @@
+#!/usr/bin/env python
+# generateScenario.py
+# Author: Phillip Taylor
+
+"""
+Generate a synthetic benchmark scenario: a grid or spider network built with
+netgenerate, random demand of configurable density routed with explicit edges
+(as required by cutRoutes.py), and a sumo cfg tying them together. The same
+options and seed always produce the same scenario.
+
+usage: generateScenario.py [options] <output dir>
+"""
+from __future__ import absolute_import
+from __future__ import print_function
+
+import os
+import sys
+import subprocess
+
+from optparse import OptionParser
+
+if 'SUMO_HOME' in os.environ:
+    sumoHome = os.environ['SUMO_HOME']
+else:
+    sys.exit("please declare environment variable 'SUMO_HOME'")
+
+
+def get_options(args=sys.argv[1:]):
+    optParser = OptionParser(usage="usage: %prog [options] <output dir>")
+    optParser.add_option("--type", default="grid", help="network type: grid or spider")
+    optParser.add_option("--size", type="int", default=10,
+                         help="junctions per grid side, or spider arms and circles")
+    optParser.add_option("--length", type="float", default=200,
+                         help="edge length for grid, ring spacing for spider (m)")
+    optParser.add_option("--lanes", type="int", default=1, help="lanes per edge")
+    optParser.add_option("--vehicles-per-hour", type="float", default=3600,
+                         help="demand density, insertion rate over the whole network")
+    optParser.add_option("--end", type="int", default=1000, help="simulation end time (s)")
+    optParser.add_option("--seed", type="int", default=42, help="random seed for demand")
+    optParser.add_option("--name", help="scenario name (default: <type><size>_<vehicles per hour>)")
+    options, args = optParser.parse_args(args=args)
+    if len(args) != 1 or options.type not in ("grid", "spider"):
+        optParser.print_help()
+        sys.exit(1)
+    options.outdir = args[0]
+    if options.name is None:
+        options.name = "%s%s_%s" % (options.type, options.size, int(options.vehicles_per_hour))
+    return options
+
+
+def call(args):
+    print(" ".join(args))
+    if subprocess.call(args) != 0:
+        sys.exit("failed: %s" % args[0])
+
+
+def main(options):
+    if not os.path.isdir(options.outdir):
+        os.makedirs(options.outdir)
+    netFile = options.name + ".net.xml"
+    rouFile = options.name + ".rou.xml"
+    cfgFile = os.path.join(options.outdir, options.name + ".sumocfg")
+
+    # network
+    netArgs = [os.path.join(sumoHome, "bin", "netgenerate"), "--default.lanenumber", str(options.lanes),
+               "--no-turnarounds", "true", "-o", os.path.join(options.outdir, netFile)]
+    if options.type == "grid":
+        netArgs += ["--grid", "--grid.number", str(options.size), "--grid.length", str(options.length)]
+    else:
+        netArgs += ["--spider", "--spider.arm-number", str(options.size),
+                    "--spider.circle-number", str(options.size), "--spider.space-radius", str(options.length),
+                    "--spider.omit-center", "true"]
+    call(netArgs)
+
+    # demand, routed by duarouter so every vehicle carries its edges
+    period = 3600.0 / options.vehicles_per_hour
+    call([sys.executable, os.path.join(sumoHome, "tools", "randomTrips.py"),
+          "-n", os.path.join(options.outdir, netFile), "-r", os.path.join(options.outdir, rouFile),
+          "-o", os.path.join(options.outdir, options.name + ".trips.xml"),
+          "-b", "0", "-e", str(options.end), "-p", str(period), "--seed", str(options.seed),
+          "--fringe-factor", "10", "--validate"])
+
+    with open(cfgFile, 'w') as f:
+        f.write("""<?xml version="1.0" encoding="UTF-8"?>
+<configuration xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance" xsi:noNamespaceSchemaLocation="http://sumo.dlr.de/xsd/sumoConfiguration.xsd">
+
+    <input>
+        <net-file value="%s"/>
+        <route-files value="%s"/>
+    </input>
+
+    <time>
+        <begin value="0"/>
+        <end value="%s"/>
+    </time>
+
+    <report>
+        <no-step-log value="true"/>
+    </report>
+
+</configuration>
+""" % (netFile, rouFile, options.end))
+    print("wrote %s" % cfgFile)
+
+
+if __name__ == "__main__":
+    main(get_options())
@@ -1,20 +1,45 @@
 /*
-Main program for running a parallel SUMO simulation. startSim() runs simulation.
-Can comment out getFilePaths() and partitionNetwork() after these functions
-have already been executed to run startSim() with same partitions.
+Main program for running a parallel SUMO simulation. Every ParallelSim
+parameter can be given as a command line flag or in a config file of
+"<option> <value>" lines (option names without the leading dashes, '#' starts
+a comment); flags override the config file, both are read by SimOptions.
+Run with --help for all options.
+With --partition none (the default) startSim() runs with the partitions
+created by an earlier run.
 
 Author: Phillip Taylor
 */
 
 #include <iostream>
 #include <cstdlib>
+#include <string>
 #include "ParallelSim.h"
+#include "SimOptions.h"
 
 int main(int argc, char* argv[]) {
-    // params: host server, first port. sumo cfg file, gui option (true), number of threads
-    ParallelSim client("localhost", 1337, "assets/simpleNet.sumocfg", true, 4);
-  //  client.getFilePaths();
+  SimOptions opts("usage: main [options]");
+  opts.parse(argc, argv, 1);
+
+  std::string cfg = opts.get("cfg", "assets/simpleNet.sumocfg");
+  std::string partition = opts.get("partition", "none");
+  if(partition != "metis" && partition != "grid" && partition != "none") {
+    std::cout << "--partition must be metis, grid or none" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // params: host server, first port. sumo cfg file, gui option (true), number of threads
+  ParallelSim client(opts.get("host", "localhost"), atoi(opts.get("port", "1337").c_str()), cfg.c_str(),
+    opts.isSet("gui"), atoi(opts.get("threads", "4").c_str()));
+
+  opts.apply(client);
+
+  if(partition != "none") {
+    client.getFilePaths();
     // param: true for metis partitioning, false for grid partitioning (only works for 2 partitions currently)
-  //  client.partitionNetwork(true);
-    client.startSim();
+    client.partitionNetwork(partition == "metis");
+  }
+  else if(opts.isSet("routes-only")) {
+    client.getFilePaths();
+    client.partitionRoutes();
+  }
+  client.startSim();
 }
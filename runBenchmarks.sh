@@ -0,0 +1,23 @@
+#!/bin/sh
+# runBenchmarks.sh
+# Author: Phillip Taylor
+#
+# Generates the benchmark scenarios and runs each through parallelbench at
+# 1 to MAX_PARTS partitions. Results go to bench/<scenario>.csv.
+# usage: runBenchmarks.sh [max partitions]
+
+set -e
+MAX_PARTS=${1:-16}
+mkdir -p bench
+
+run() {
+  name=$1
+  shift
+  python3 generateScenario.py --name "$name" "$@" bench
+  ./parallelbench "bench/$name.sumocfg" "$MAX_PARTS" "bench/$name.csv"
+}
+
+# scenario name, network and demand
+run grid10_light --type grid --size 10 --vehicles-per-hour 1800
+run grid20_dense --type grid --size 20 --lanes 2 --vehicles-per-hour 14400
+run spider12 --type spider --size 12 --vehicles-per-hour 7200
@@ -19,6 +19,8 @@
 #ifndef WIN32
 	#include <sys/types.h>
 	#include <sys/socket.h>
+	#include <sys/uio.h>
+	#include <sys/un.h>
 	#include <netinet/in.h>
 	#include <netinet/tcp.h>
 	#include <arpa/inet.h>
@@ -60,7 +62,19 @@
 
 namespace tcpip
 {
+	namespace
+	{
+		/// Decode the 4 byte length prefix of a TraCI message
+		std::size_t decodeLength(const unsigned char* lengthBytes)
+		{
+			return (static_cast<std::size_t>(lengthBytes[0]) << 24) | (lengthBytes[1] << 16)
+				| (lengthBytes[2] << 8) | lengthBytes[3];
+		}
+	}
+
 	const int Socket::lengthLen = 4;
+	const std::size_t Socket::readChunk = 65536;
+	const std::string Socket::unixPrefix = "unix:";
 
 #ifdef WIN32
 	bool Socket::init_windows_sockets_ = true;
@@ -76,6 +90,8 @@ namespace tcpip
 		socket_(-1),
 		server_socket_(-1),
 		blocking_(true),
+		recvStart_(0),
+		recvEnd_(0),
 		verbose_(false)
 	{
 		init();
@@ -89,6 +105,8 @@ namespace tcpip
 		socket_(-1),
 		server_socket_(-1),
 		blocking_(true),
+		recvStart_(0),
+		recvEnd_(0),
 		verbose_(false)
 	{
 		init();
@@ -159,6 +177,8 @@ namespace tcpip
 			::closesocket( server_socket_ );
 #else
 			::close( server_socket_ );
+			if( is_unix() )
+				::unlink( unixPath().c_str() );
 #endif
 			server_socket_ = -1;
 		}
@@ -254,6 +274,16 @@ namespace tcpip
 	}
 
 
+	// ----------------------------------------------------------------------
+	std::string
+		Socket::
+		unixPath()
+		const
+	{
+		return host_.substr(unixPrefix.size());
+	}
+
+
 	// ----------------------------------------------------------------------
 	Socket*
 		Socket::
@@ -269,6 +299,37 @@ namespace tcpip
 		socklen_t addrlen = sizeof(client_addr);
 #endif
 
+		if( server_socket_ < 0 && is_unix() )
+		{
+#ifdef WIN32
+			throw SocketException("tcpip::Socket::accept() Unix domain sockets are not supported");
+#else
+			struct sockaddr_un self;
+			const std::string path = unixPath();
+			if( path.size() >= sizeof(self.sun_path) )
+				throw SocketException("tcpip::Socket::accept() Unix socket path too long: " + path);
+
+			server_socket_ = static_cast<int>(socket( AF_UNIX, SOCK_STREAM, 0 ));
+			if( server_socket_ < 0 )
+				BailOnSocketError("tcpip::Socket::accept() @ socket");
+
+			// remove a stale socket file of a previous run
+			::unlink( path.c_str() );
+
+			memset(&self, 0, sizeof(self));
+			self.sun_family = AF_UNIX;
+			strncpy(self.sun_path, path.c_str(), sizeof(self.sun_path) - 1);
+
+			if ( bind(server_socket_, (struct sockaddr*)&self, sizeof(self)) != 0 )
+				BailOnSocketError("tcpip::Socket::accept() Unable to create listening socket");
+
+			if ( listen(server_socket_, 10) == -1 )
+				BailOnSocketError("tcpip::Socket::accept() Unable to listen on server socket");
+
+			set_blocking(blocking_);
+#endif
+		}
+
 		if( server_socket_ < 0 )
 		{
 			struct sockaddr_in self;
@@ -309,14 +370,20 @@ namespace tcpip
 			set_blocking(blocking_);
 		}
 
-		socket_ = static_cast<int>(::accept(server_socket_, (struct sockaddr*)&client_addr, &addrlen));
+		if( is_unix() )
+			socket_ = static_cast<int>(::accept(server_socket_, nullptr, nullptr));
+		else
+			socket_ = static_cast<int>(::accept(server_socket_, (struct sockaddr*)&client_addr, &addrlen));
 
 		if( socket_ >= 0 )
 		{
-			int x = 1;
-			setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, (const char*)&x, sizeof(x));
+			if( !is_unix() )
+			{
+				int x = 1;
+				setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, (const char*)&x, sizeof(x));
+			}
             if (create) {
-                Socket* result = new Socket(0);
+                Socket* result = is_unix() ? new Socket(host_, 0) : new Socket(0);
                 result->socket_ = socket_;
                 socket_ = -1;
                 return result;
@@ -357,6 +424,30 @@ namespace tcpip
 		Socket::
 		connect()
 	{
+		if( is_unix() )
+		{
+#ifdef WIN32
+			throw SocketException("tcpip::Socket::connect() Unix domain sockets are not supported");
+#else
+			struct sockaddr_un address;
+			const std::string path = unixPath();
+			if( path.size() >= sizeof(address.sun_path) )
+				throw SocketException("tcpip::Socket::connect() Unix socket path too long: " + path);
+
+			memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+			socket_ = static_cast<int>(socket( AF_UNIX, SOCK_STREAM, 0 ));
+			if( socket_ < 0 )
+				BailOnSocketError("tcpip::Socket::connect() @ socket");
+
+			if( ::connect( socket_, (sockaddr const*)&address, sizeof(address) ) < 0 )
+				BailOnSocketError("tcpip::Socket::connect() @ connect");
+			return;
+#endif
+		}
+
 		sockaddr_in address;
 
 		if( !atoaddr( host_.c_str(), address) )
@@ -392,6 +483,8 @@ namespace tcpip
 
 			socket_ = -1;
 		}
+		// unread bytes belong to the closed connection
+		recvStart_ = recvEnd_ = 0;
 	}
 
 	// ----------------------------------------------------------------------
@@ -429,17 +522,75 @@ namespace tcpip
 		Socket::
 		sendExact( const Storage &b)
 	{
-		int length = static_cast<int>(b.size());
-		Storage length_storage;
-		length_storage.writeInt(lengthLen + length);
-
-		// Sending length_storage and b independently would probably be possible and
-		// avoid some copying here, but both parts would have to go through the
-		// TCP/IP stack on their own which probably would cost more performance.
-		std::vector<unsigned char> msg;
-		msg.insert(msg.end(), length_storage.begin(), length_storage.end());
-		msg.insert(msg.end(), b.begin(), b.end());
+		const std::size_t length = b.size();
+		// length prefix in network byte order
+		const unsigned int totalLen = static_cast<unsigned int>(lengthLen + length);
+		unsigned char header[4];
+		header[0] = static_cast<unsigned char>(totalLen >> 24);
+		header[1] = static_cast<unsigned char>(totalLen >> 16);
+		header[2] = static_cast<unsigned char>(totalLen >> 8);
+		header[3] = static_cast<unsigned char>(totalLen);
+
+		// header and payload leave in one syscall without being copied together
+		sendFramed(header, lengthLen, b.data(), length);
+	}
+
+
+	// ----------------------------------------------------------------------
+	void
+		Socket::
+		sendFramed(const unsigned char * header, std::size_t headerLen, const unsigned char * body, std::size_t bodyLen)
+	{
+		if( socket_ < 0 )
+			return;
+
+		if (verbose_)
+		{
+			std::vector<unsigned char> msg(header, header + headerLen);
+			msg.insert(msg.end(), body, body + bodyLen);
+			printBufferOnVerbose(msg, "Send");
+		}
+
+#ifdef WIN32
+		std::vector<unsigned char> msg(header, header + headerLen);
+		msg.insert(msg.end(), body, body + bodyLen);
+		const bool verbose = verbose_;
+		verbose_ = false;
 		send(msg);
+		verbose_ = verbose;
+#else
+		struct iovec iov[2];
+		iov[0].iov_base = const_cast<unsigned char*>(header);
+		iov[0].iov_len = headerLen;
+		iov[1].iov_base = const_cast<unsigned char*>(body);
+		iov[1].iov_len = bodyLen;
+		struct iovec *vec = iov;
+		int count = bodyLen > 0 ? 2 : 1;
+		while( count > 0 )
+		{
+			const ssize_t bytesSent = ::writev( socket_, vec, count );
+			if( bytesSent < 0 )
+			{
+				if( errno == EINTR )
+					continue;
+				BailOnSocketError( "send failed" );
+			}
+
+			// skip what has been sent, usually everything in the first call
+			std::size_t sent = static_cast<std::size_t>(bytesSent);
+			while( count > 0 && sent >= vec->iov_len )
+			{
+				sent -= vec->iov_len;
+				++vec;
+				--count;
+			}
+			if( count > 0 )
+			{
+				vec->iov_base = static_cast<unsigned char*>(vec->iov_base) + sent;
+				vec->iov_len -= sent;
+			}
+		}
+#endif
 	}
 
 
@@ -506,6 +657,16 @@ namespace tcpip
 		if( socket_ < 0 )
 			connect();
 
+		// hand out bytes a previous receiveExact read ahead first
+		if( recvEnd_ > recvStart_ )
+		{
+			const std::size_t available = std::min(recvEnd_ - recvStart_, static_cast<std::size_t>(bufSize));
+			buffer.assign(&recvBuffer_[recvStart_], &recvBuffer_[recvStart_] + available);
+			recvStart_ += available;
+			printBufferOnVerbose(buffer, "Rcvd");
+			return buffer;
+		}
+
 		if( !datawaiting( socket_) )
 			return buffer;
 
@@ -522,37 +683,123 @@ namespace tcpip
 	// ----------------------------------------------------------------------
 	
 
+	void
+		Socket::
+		fillReceiveBuffer(std::size_t len)
+	{
+		if( recvEnd_ - recvStart_ >= len )
+			return;
+
+		prepareReceiveBuffer(len);
+
+		// each recv takes whatever is available, possibly several messages
+		while( recvEnd_ < len )
+			recvEnd_ += recvAndCheck(&recvBuffer_[recvEnd_], recvBuffer_.size() - recvEnd_);
+	}
+
+
+	// ----------------------------------------------------------------------
+	void
+		Socket::
+		prepareReceiveBuffer(std::size_t len)
+	{
+		// move the unread tail to the front before growing the buffer
+		if( recvStart_ > 0 )
+		{
+			if( recvEnd_ > recvStart_ )
+				memmove(&recvBuffer_[0], &recvBuffer_[recvStart_], recvEnd_ - recvStart_);
+			recvEnd_ -= recvStart_;
+			recvStart_ = 0;
+		}
+		if( recvBuffer_.size() < std::max(len, readChunk) )
+			recvBuffer_.resize(std::max(len, readChunk));
+	}
+
+
+	// ----------------------------------------------------------------------
 	bool
 		Socket::
-		receiveExact( Storage &msg )
+		messageBuffered()
+		const
 	{
-		// buffer for received bytes
-		// According to the C++ standard elements of a std::vector are stored
-		// contiguously. Explicitly &buffer[n] == &buffer[0] + n for 0 <= n < buffer.size().
-		std::vector<unsigned char> buffer(lengthLen);
+		if( recvEnd_ - recvStart_ < static_cast<std::size_t>(lengthLen) )
+			return false;
+		return recvEnd_ - recvStart_ >= decodeLength(&recvBuffer_[recvStart_]);
+	}
 
+
+	// ----------------------------------------------------------------------
+	bool
+		Socket::
+		receiveExact( Storage &msg )
+	{
 		// receive length of TraCI message
-		receiveComplete(&buffer[0], lengthLen);
-		Storage length_storage(&buffer[0], lengthLen);
-		const int totalLen = length_storage.readInt();
+		fillReceiveBuffer(lengthLen);
+		const int totalLen = static_cast<int>(decodeLength(&recvBuffer_[recvStart_]));
 		assert(totalLen > lengthLen);
 
-		// extent buffer
-		buffer.resize(totalLen);
-
 		// receive remaining TraCI message
-		receiveComplete(&buffer[lengthLen], totalLen - lengthLen);
+		fillReceiveBuffer(totalLen);
 
 		// copy message content into passed Storage
 		msg.reset();
-		msg.writePacket(&buffer[lengthLen], totalLen - lengthLen);
-		
-		printBufferOnVerbose(buffer, "Rcvd Storage with");
+		msg.writePacket(&recvBuffer_[recvStart_ + lengthLen], totalLen - lengthLen);
+
+		if (verbose_)
+			printBufferOnVerbose(std::vector<unsigned char>(&recvBuffer_[recvStart_], &recvBuffer_[recvStart_] + totalLen), "Rcvd Storage with");
+
+		recvStart_ += totalLen;
+		if( recvStart_ == recvEnd_ )
+			recvStart_ = recvEnd_ = 0;
 
 		return true;
 	}
 	
 	
+	// ----------------------------------------------------------------------
+	bool
+		Socket::
+		tryReceiveExact( Storage &msg )
+	{
+		if( !messageBuffered() )
+		{
+			// grow to the announced message length once it is known
+			std::size_t want = readChunk;
+			if( recvEnd_ - recvStart_ >= static_cast<std::size_t>(lengthLen) )
+				want = std::max(want, decodeLength(&recvBuffer_[recvStart_]));
+			prepareReceiveBuffer(want);
+#ifdef WIN32
+			if( !datawaiting(socket_) )
+				return false;
+			const int bytesReceived = recv( socket_, (char*)&recvBuffer_[recvEnd_], static_cast<int>(recvBuffer_.size() - recvEnd_), 0 );
+#else
+			const int bytesReceived = static_cast<int>(recv( socket_, &recvBuffer_[recvEnd_], recvBuffer_.size() - recvEnd_, MSG_DONTWAIT ));
+			if( bytesReceived < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) )
+				return false;
+#endif
+			if( bytesReceived == 0 )
+				throw SocketException( "tcpip::Socket::tryReceiveExact @ recv: peer shutdown" );
+			if( bytesReceived < 0 )
+				BailOnSocketError( "tcpip::Socket::tryReceiveExact @ recv" );
+			recvEnd_ += bytesReceived;
+			if( !messageBuffered() )
+				return false;
+		}
+		// the whole message is buffered, receiveExact does not block
+		return receiveExact(msg);
+	}
+
+
+	// ----------------------------------------------------------------------
+	int
+		Socket::
+		get_socket()
+		const
+	{
+		return socket_;
+	}
+
+
 	// ----------------------------------------------------------------------
 	bool 
 		Socket::
@@ -562,6 +809,15 @@ namespace tcpip
 		return socket_ >= 0;
 	}
 
+	// ----------------------------------------------------------------------
+	bool
+		Socket::
+		is_unix()
+		const
+	{
+		return host_.compare(0, unixPrefix.size(), unixPrefix) == 0;
+	}
+
 	// ----------------------------------------------------------------------
 	bool 
 		Socket::
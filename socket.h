@@ -62,6 +62,7 @@ namespace tcpip
 		friend class Response;
 	public:
 		/// Constructor that prepare to connect to host:port 
+		/// @note A host of the form "unix:<path>" selects a Unix domain socket at <path>, port is ignored then
 		Socket(std::string host, int port);
 		
 		/// Constructor that prepare for accepting a connection on given port
@@ -86,22 +87,43 @@ namespace tcpip
 		std::vector<unsigned char> receive( int bufSize = 2048 );
 		/// Receive a complete TraCI message from Socket::socket_
 		bool receiveExact( Storage &);
+		/// Receive a complete TraCI message if it is available without blocking.
+		/// Reads at most once from Socket::socket_, returns false if the message is still incomplete.
+		bool tryReceiveExact( Storage &);
+		/// Returns the descriptor of the client connection, e.g. for polling it
+		int get_socket() const;
 		void close();
 		int port();
 		void set_blocking(bool);
 		bool is_blocking();
 		bool has_client_connection() const;
+		/// Returns true if this socket uses a Unix domain endpoint instead of TCP
+		bool is_unix() const;
 
 		// If verbose, each send and received data is written to stderr
 		bool verbose() { return verbose_; }
 		void set_verbose(bool newVerbose) { verbose_ = newVerbose; }
 
+		/// Prefix of host names which denote a Unix domain socket path
+		static const std::string unixPrefix;
+
 	protected:
 		/// Length of the message length part of a TraCI message
 		static const int lengthLen;
 
+		/// Size of a single read into the receive buffer
+		static const std::size_t readChunk;
+
 		/// Receive \p len bytes from Socket::socket_
 		void receiveComplete(unsigned char * const buffer, std::size_t len) const;
+		/// Receive until at least \p len unread bytes are in the receive buffer
+		void fillReceiveBuffer(std::size_t len);
+		/// Make room for \p len unread bytes in the receive buffer
+		void prepareReceiveBuffer(std::size_t len);
+		/// Returns true if a complete TraCI message is in the receive buffer
+		bool messageBuffered() const;
+		/// Send \p headerLen bytes of \p header followed by \p bodyLen bytes of \p body
+		void sendFramed(const unsigned char * header, std::size_t headerLen, const unsigned char * body, std::size_t bodyLen);
 		/// Receive up to \p len available bytes from Socket::socket_
 		size_t recvAndCheck(unsigned char * const buffer, std::size_t len) const;
 		/// Print \p label and \p buffer to stderr if Socket::verbose_ is set
@@ -114,6 +136,8 @@ namespace tcpip
 		static std::string GetWinsockErrorString(int err);
 #endif
 		bool atoaddr(std::string, struct sockaddr_in& addr);
+		/// Path of the Unix domain socket, taken from host_
+		std::string unixPath() const;
 		bool datawaiting(int sock) const;
 
 		std::string host_;
@@ -122,6 +146,12 @@ namespace tcpip
 		int server_socket_;
 		bool blocking_;
 
+		/// Bytes received but not yet consumed, a single recv may return several messages
+		std::vector<unsigned char> recvBuffer_;
+		/// Unread bytes are recvBuffer_[recvStart_, recvEnd_)
+		std::size_t recvStart_;
+		std::size_t recvEnd_;
+
 		bool verbose_;
 #ifdef WIN32
 		static bool init_windows_sockets_;
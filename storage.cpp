@@ -28,103 +28,13 @@
 namespace tcpip
 {
 
-	// ----------------------------------------------------------------------
-	Storage::Storage()
-	{
-		init();
-	}
-
-
 	// ----------------------------------------------------------------------
 	Storage::Storage(const unsigned char packet[], int length)
+		: pos_(0)
 	{
 		assert(length >= 0); // fixed MB, 2015-04-21
 
-		store.reserve(length);
-		// Get the content
-		for(int i = 0; i < length; ++i) store.push_back(packet[i]);
-
-		init();
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::init()
-	{
-		// Initialize local variables
-		iter_ = store.begin();
-
-		short a = 0x0102;
-		unsigned char *p_a = reinterpret_cast<unsigned char*>(&a);
-		bigEndian_ = (p_a[0] == 0x01); // big endian?
-	}
-
-
-	// ----------------------------------------------------------------------
-	Storage::~Storage()
-	{}
-
-
-	// ----------------------------------------------------------------------
-	bool Storage::valid_pos()
-	{
-		return (iter_ != store.end());   // this implies !store.empty()
-	}
-
-
-	// ----------------------------------------------------------------------
-	unsigned int Storage::position() const
-	{
-		// According to C++ standard std::distance will simply compute the iterators
-		// difference for random access iterators as std::vector provides.
-		return static_cast<unsigned int>(std::distance(store.begin(), iter_));
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::reset()
-	{
-		store.clear();
-		iter_ = store.begin();
-	}
-
-
-	// ----------------------------------------------------------------------
-	/**
-	* Reads a char form the array
-	* @return The read char (between 0 and 255)
-	*/
-	unsigned char Storage::readChar()
-	{
-		if ( !valid_pos() )
-		{
-			throw std::invalid_argument("Storage::readChar(): invalid position");
-		}
-		return readCharUnsafe();
-	}
-
-
-	// ----------------------------------------------------------------------
-	/**
-	*
-	*/
-	void Storage::writeChar(unsigned char value)
-	{
-		store.push_back(value);
-		iter_ = store.begin();
-	}
-
-
-	// ----------------------------------------------------------------------
-	/**
-	* Reads a byte form the array
-	* @return The read byte (between -128 and 127)
-	*/
-	int Storage::readByte()
-	{
-		int i = static_cast<int>(readChar());
-		if (i < 128) return i;
-		else return (i - 256);
+		store.assign(packet, packet + length);
 	}
 
 
@@ -142,17 +52,6 @@ namespace tcpip
 	}
 
 
-	// ----------------------------------------------------------------------
-	/**
-	* Reads an unsigned byte form the array
-	* @return The read byte (between 0 and 255)
-	*/
-	int Storage::readUnsignedByte()
-	{
-		return static_cast<int>(readChar());
-	}
-
-
 	// ----------------------------------------------------------------------
 	/**
 	*
@@ -174,13 +73,39 @@ namespace tcpip
 	*/
 	std::string Storage::readString()
 	{
-		int len = readInt();
+		const StringRef ref = readStringRef();
+		return std::string(ref.data(), ref.size());
+	}
+
+
+	// -----------------------------------------------------------------------
+	/**
+	* Reads a string form the array into an existing string
+	* @param into	The string to be overwritten
+	*/
+	void Storage::readString(std::string& into)
+	{
+		const StringRef ref = readStringRef();
+		into.assign(ref.data(), ref.size());
+	}
+
+
+	// -----------------------------------------------------------------------
+	/**
+	* Reads a string form the array without copying it
+	* @return A reference to the string bytes inside the storage
+	*/
+	Storage::StringRef Storage::readStringRef()
+	{
+		const int len = readInt();
+		if (len < 0)
+		{
+			throw std::invalid_argument("Storage::readString(): negative length");
+		}
 		checkReadSafe(len);
-		StorageType::const_iterator end = iter_;
-		std::advance(end, len);
-		const std::string tmp(iter_, end);
-		iter_ = end;
-		return tmp;
+		const StringRef ref(len == 0 ? "" : reinterpret_cast<const char*>(&store[pos_]), len);
+		pos_ += len;
+		return ref;
 	}
 
 
@@ -194,7 +119,7 @@ namespace tcpip
 		writeInt(static_cast<int>(s.length()));
 
 		store.insert(store.end(), s.begin(), s.end());
-		iter_ = store.begin();
+		pos_ = 0;
 	}
 
 
@@ -206,13 +131,29 @@ namespace tcpip
     std::vector<std::string> Storage::readStringList()
     {
         std::vector<std::string> tmp;
+        readStringList(tmp);
+        return tmp;
+    }
+
+
+    // -----------------------------------------------------------------------
+    /**
+    * Reads a string list form the array into an existing vector
+    * @param into   The vector to be overwritten
+    */
+    void Storage::readStringList(std::vector<std::string>& into)
+    {
         const int len = readInt();
-        tmp.reserve(len);
+        if (len < 0)
+        {
+            throw std::invalid_argument("Storage::readStringList(): negative length");
+        }
+        // resize keeps the strings (and their buffers) of a previous read
+        into.resize(len);
         for (int i = 0; i < len; i++)
         {
-            tmp.push_back(readString());
+            readString(into[i]);
         }
-        return tmp;
     }
 
 
@@ -264,23 +205,6 @@ namespace tcpip
     }
 
 
-	// ----------------------------------------------------------------------
-	/**
-	* Restores an integer, which was split up in two bytes according to the
-	* specification, it must have been split by its row byte representation
-	* with MSBF-order
-	*
-	* @return the unspoiled integer value (between -32768 and 32767)
-	*/
-	int Storage::readShort()
-	{
-		short value = 0;
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		readByEndianess(p_value, 2);
-		return value;
-	}
-
-
 	// ----------------------------------------------------------------------
 	void Storage::writeShort( int value )
 	{
@@ -290,152 +214,41 @@ namespace tcpip
 		}
 
 		short svalue = static_cast<short>(value);
-		unsigned char *p_svalue = reinterpret_cast<unsigned char*>(&svalue);
-		writeByEndianess(p_svalue, 2);
+		writeByEndianess<2>(&svalue);
 	}
 
 
 	// ----------------------------------------------------------------------
-	/**
-	* restores an integer, which was split up in four bytes acording to the
-	* specification, it must have been split by its row byte representation
-	* with MSBF-order
-	*
-	* @return the unspoiled integer value (between -2.147.483.648 and 2.147.483.647)
-	*/
-	int Storage::readInt()
-	{
-		int value = 0;
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		readByEndianess(p_value, 4);
-		return value;
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::writeInt( int value )
+	void Storage::writePacket(const unsigned char* packet, int length)
 	{
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		writeByEndianess(p_value, 4);
-	}
-
-
-	// ----------------------------------------------------------------------
-	/**
-	* restores a float , which was split up in four bytes acording to the
-	* specification, it must have been split by its row byte representation
-	* with MSBF-order
-	*
-	* @return the unspoiled float value
-	*/
-	float Storage::readFloat()
-	{
-		float value = 0;
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		readByEndianess(p_value, 4);
-		return value;
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::writeFloat( float value )
-	{
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		writeByEndianess(p_value, 4);
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::writeDouble( double value )
-	{
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		writeByEndianess(p_value, 8);
-	}
-
-
-	// ----------------------------------------------------------------------
-	double Storage::readDouble( )
-	{
-		double value = 0;
-		unsigned char *p_value = reinterpret_cast<unsigned char*>(&value);
-		readByEndianess(p_value, 8);
-		return value;
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::writePacket(unsigned char* packet, int length)
-	{
-		store.insert(store.end(), &(packet[0]), &(packet[length]));
-		iter_ = store.begin();   // reserve() invalidates iterators
+		store.insert(store.end(), packet, packet + length);
+		pos_ = 0;
 	}
 
 
 	// ----------------------------------------------------------------------
     void Storage::writePacket(const std::vector<unsigned char> &packet)
     {
-        std::copy(packet.begin(), packet.end(), std::back_inserter(store));
-		iter_ = store.begin();
+        store.insert(store.end(), packet.begin(), packet.end());
+		pos_ = 0;
     }
 
 
 	// ----------------------------------------------------------------------
 	void Storage::writeStorage(tcpip::Storage& other)
 	{
-		// the compiler cannot deduce to use a const_iterator as source
-		store.insert<StorageType::const_iterator>(store.end(), other.iter_, other.store.end());
-		iter_ = store.begin();
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::checkReadSafe(unsigned int num) const 
-	{
-		if (std::distance(iter_, store.end()) < static_cast<int>(num))
-		{
-			std::ostringstream msg;
-			msg << "tcpip::Storage::readIsSafe: want to read "  << num << " bytes from Storage, "
-				<< "but only " << std::distance(iter_, store.end()) << " remaining";
-			throw std::invalid_argument(msg.str());
-		}
-	}
-
-
-	// ----------------------------------------------------------------------
-	unsigned char Storage::readCharUnsafe()
-	{
-		char hb = *iter_;
-		++iter_;
-		return hb;
+		store.insert(store.end(), other.store.begin() + other.pos_, other.store.end());
+		pos_ = 0;
 	}
 
 
 	// ----------------------------------------------------------------------
-	void Storage::writeByEndianess(const unsigned char * begin, unsigned int size)
+	void Storage::throwReadUnsafe(unsigned int num) const
 	{
-		const unsigned char * end = &(begin[size]);
-		if (bigEndian_)
-			store.insert(store.end(), begin, end);
-		else
-			store.insert(store.end(), std::reverse_iterator<const unsigned char *>(end), std::reverse_iterator<const unsigned char *>(begin));
-		iter_ = store.begin();
-	}
-
-
-	// ----------------------------------------------------------------------
-	void Storage::readByEndianess(unsigned char * array, int size)
-	{
-		checkReadSafe(size);
-		if (bigEndian_)
-		{
-			for (int i = 0; i < size; ++i)
-				array[i] = readCharUnsafe();
-		}
-		else
-		{
-			for (int i = size - 1; i >= 0; --i)
-				array[i] = readCharUnsafe();
-		}
+		std::ostringstream msg;
+		msg << "tcpip::Storage::readIsSafe: want to read "  << num << " bytes from Storage, "
+			<< "but only " << store.size() - pos_ << " remaining";
+		throw std::invalid_argument(msg.str());
 	}
 
 
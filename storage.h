@@ -28,9 +28,18 @@
 
 #include <vector>
 #include <string>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 
+// TraCI transmits all fixed-width values in network byte order
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+	#define TCPIP_BIG_ENDIAN_HOST (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#else
+	// all supported compilers without __BYTE_ORDER__ (MSVC) target little endian hosts
+	#define TCPIP_BIG_ENDIAN_HOST 0
+#endif
+
 namespace tcpip
 {
 
@@ -40,85 +49,213 @@ class Storage
 public:
 	typedef std::vector<unsigned char> StorageType;
 
+	/// Non-owning view of a string inside a Storage.
+	/// Only valid until the Storage is written to, reset or destroyed.
+	class StringRef
+	{
+	public:
+		StringRef() : data_(nullptr), size_(0) {}
+		StringRef(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+		const char* data() const { return data_; }
+		std::size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		/// Copy the referenced characters into a new string
+		std::string str() const { return std::string(data_, size_); }
+
+		bool operator==(const std::string& other) const
+		{
+			return other.size() == size_ && (size_ == 0 || std::memcmp(data_, other.data(), size_) == 0);
+		}
+		bool operator!=(const std::string& other) const { return !(*this == other); }
+
+	private:
+		const char* data_;
+		std::size_t size_;
+	};
+
 private:
 	StorageType store;
-	StorageType::const_iterator iter_;
-
-	// sortation of bytes forwards or backwards?
-	bool bigEndian_;
-
-	/// Used in constructors to initialize local variables
-	void init();
+	/// Read position, an index stays valid when the vector reallocates
+	StorageType::size_type pos_;
 
 	/// Check if the next \p num bytes can be read safely
-	void checkReadSafe(unsigned int num) const;
-	/// Read a byte \em without validity check
-	unsigned char readCharUnsafe();
-	/// Write \p size elements of array \p begin according to endianess
-	void writeByEndianess(const unsigned char * begin, unsigned int size);
-	/// Read \p size elements into \p array according to endianess
-	void readByEndianess(unsigned char * array, int size);
+	void checkReadSafe(unsigned int num) const
+	{
+		if (store.size() - pos_ < num)
+			throwReadUnsafe(num);
+	}
+	/// Throws the exception for a failed checkReadSafe, kept out of line
+	void throwReadUnsafe(unsigned int num) const;
+
+	/// Append the \p N bytes at \p value in network byte order
+	template <unsigned int N>
+	void writeByEndianess(const void* value)
+	{
+		unsigned char buf[N];
+		copyByEndianess<N>(buf, static_cast<const unsigned char*>(value));
+		store.insert(store.end(), buf, buf + N);
+		pos_ = 0;
+	}
+
+	/// Read \p N bytes in network byte order into \p value
+	template <unsigned int N>
+	void readByEndianess(void* value)
+	{
+		checkReadSafe(N);
+		copyByEndianess<N>(static_cast<unsigned char*>(value), &store[pos_]);
+		pos_ += N;
+	}
+
+	/// Copy \p N bytes, reversing them on little endian hosts.
+	/// N is known at compile time so this reduces to a single load/bswap/store.
+	template <unsigned int N>
+	static void copyByEndianess(unsigned char* dest, const unsigned char* src)
+	{
+#if TCPIP_BIG_ENDIAN_HOST
+		std::memcpy(dest, src, N);
+#else
+		for (unsigned int i = 0; i < N; ++i)
+			dest[i] = src[N - 1 - i];
+#endif
+	}
 
 
 public:
 
 	/// Standard Constructor
-	Storage();
+	Storage() : pos_(0) {}
 
 	/// Constructor, that fills the storage with an char array. If length is -1, the whole array is handed over
 	Storage(const unsigned char[], int length=-1);
 
 	// Destructor
-	virtual ~Storage();
-
-	virtual bool valid_pos();
-	virtual unsigned int position() const;
-
-	void reset();
+	~Storage() {}
+
+	bool valid_pos() const { return pos_ < store.size(); }
+	unsigned int position() const { return static_cast<unsigned int>(pos_); }
+
+	/// Empty the storage, the allocated capacity is kept for the next message
+	void reset()
+	{
+		store.clear();
+		pos_ = 0;
+	}
+	/// Make room for \p size bytes without reallocating on subsequent writes
+	void reserve(StorageType::size_type size) { store.reserve(size); }
 	/// Dump storage content as series of hex values
 	std::string hexDump() const;
 
-	virtual unsigned char readChar();
-	virtual void writeChar(unsigned char);
-
-	virtual int readByte();
-	virtual void writeByte(int);
-//	virtual void writeByte(unsigned char);
-
-	virtual int readUnsignedByte();
-	virtual void writeUnsignedByte(int);
-
-	virtual std::string readString();
-	virtual void writeString(const std::string& s);
-
-    virtual std::vector<std::string> readStringList();
-    virtual void writeStringList(const std::vector<std::string> &s);
-
-    virtual std::vector<double> readDoubleList();
-    virtual void writeDoubleList(const std::vector<double> &s);
-
-	virtual int readShort();
-	virtual void writeShort(int);
-
-	virtual int readInt();
-	virtual void writeInt(int);
-
-	virtual float readFloat();
-	virtual void writeFloat( float );
-
-	virtual double readDouble();
-	virtual void writeDouble( double );
-
-	virtual void writePacket(unsigned char* packet, int length);
-    virtual void writePacket(const std::vector<unsigned char> &packet);
-
-	virtual void writeStorage(tcpip::Storage& store);
+	/**
+	* Reads a char form the array
+	* @return The read char (between 0 and 255)
+	*/
+	unsigned char readChar()
+	{
+		if ( !valid_pos() )
+		{
+			throw std::invalid_argument("Storage::readChar(): invalid position");
+		}
+		return store[pos_++];
+	}
+	void writeChar(unsigned char value)
+	{
+		store.push_back(value);
+		pos_ = 0;
+	}
+
+	/**
+	* Reads a byte form the array
+	* @return The read byte (between -128 and 127)
+	*/
+	int readByte()
+	{
+		int i = static_cast<int>(readChar());
+		if (i < 128) return i;
+		else return (i - 256);
+	}
+	void writeByte(int);
+
+	/**
+	* Reads an unsigned byte form the array
+	* @return The read byte (between 0 and 255)
+	*/
+	int readUnsignedByte() { return static_cast<int>(readChar()); }
+	void writeUnsignedByte(int);
+
+	std::string readString();
+	/// Read a string into \p into, reusing its capacity
+	void readString(std::string& into);
+	/// Read a string without copying it out of the storage
+	StringRef readStringRef();
+	void writeString(const std::string& s);
+
+	std::vector<std::string> readStringList();
+	/// Read a string list into \p into, reusing the capacity of the vector and its strings
+	void readStringList(std::vector<std::string>& into);
+	void writeStringList(const std::vector<std::string> &s);
+
+	std::vector<double> readDoubleList();
+	void writeDoubleList(const std::vector<double> &s);
+
+	/**
+	* Restores an integer, which was split up in two bytes according to the
+	* specification, it must have been split by its row byte representation
+	* with MSBF-order
+	*
+	* @return the unspoiled integer value (between -32768 and 32767)
+	*/
+	int readShort()
+	{
+		short value = 0;
+		readByEndianess<2>(&value);
+		return value;
+	}
+	void writeShort(int);
+
+	/**
+	* restores an integer, which was split up in four bytes acording to the
+	* specification, it must have been split by its row byte representation
+	* with MSBF-order
+	*
+	* @return the unspoiled integer value (between -2.147.483.648 and 2.147.483.647)
+	*/
+	int readInt()
+	{
+		int value = 0;
+		readByEndianess<4>(&value);
+		return value;
+	}
+	void writeInt(int value) { writeByEndianess<4>(&value); }
+
+	float readFloat()
+	{
+		float value = 0;
+		readByEndianess<4>(&value);
+		return value;
+	}
+	void writeFloat(float value) { writeByEndianess<4>(&value); }
+
+	double readDouble()
+	{
+		double value = 0;
+		readByEndianess<8>(&value);
+		return value;
+	}
+	void writeDouble(double value) { writeByEndianess<8>(&value); }
+
+	void writePacket(const unsigned char* packet, int length);
+	void writePacket(const std::vector<unsigned char> &packet);
+
+	void writeStorage(tcpip::Storage& store);
 
 	// Some enabled functions of the underlying std::list
 	StorageType::size_type size() const { return store.size(); }
 
 	StorageType::const_iterator begin() const { return store.begin(); }
 	StorageType::const_iterator end() const { return store.end(); }
+	/// Contiguous content of the storage, e.g. for handing it to the socket layer
+	const unsigned char* data() const { return store.data(); }
 
 };
 